@@ -6,27 +6,78 @@
 //
 
 #include <stdio.h>
+#include <algorithm>
+#include <utility>
 
 #include "AdjacencyList.h"
 
-// add a similar enough neighbor to a node's adjacency list
-void AdjacencyList::addNeighbor(int node, int neighbor) {
-  auto it = adjList.find(node);
-  if (it != adjList.end()) // if key term exists
-    it->second.insert(neighbor);
-  else
-    adjList[node] = {neighbor}; // create new set for that key
+void AdjacencyList::build(int n_terms, std::vector<EdgeBuffer>& buffers, bool keepScores) {
+  // count both directions of every edge, then lay the rows out back to back
+  std::vector<size_t> degree(size_t(n_terms) + 1, 0);
+  for (const EdgeBuffer& buffer : buffers) {
+    for (const Edge& e : buffer) {
+      if (e.node == e.neighbor) continue;
+      degree[e.node]++;
+      degree[e.neighbor]++;
+    }
+  }
+  offsets.assign(size_t(n_terms) + 1, 0);
+  for (int i = 0; i < n_terms; ++i)
+    offsets[i + 1] = offsets[i] + degree[i];
+
+  std::vector<std::pair<int, double>> rows(offsets[n_terms]);
+  std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+  for (EdgeBuffer& buffer : buffers) {
+    for (const Edge& e : buffer) {
+      if (e.node == e.neighbor) continue;
+      rows[cursor[e.node]++] = {e.neighbor, e.score};
+      rows[cursor[e.neighbor]++] = {e.node, e.score};
+    }
+    EdgeBuffer().swap(buffer); // free as we go
+  }
+
+  // sort every row and drop duplicates (an edge may have been found twice)
+  neighbors.clear();
+  scores.clear();
+  neighbors.reserve(rows.size());
+  if (keepScores)
+    scores.reserve(rows.size());
+  size_t start = 0;
+  for (int i = 0; i < n_terms; ++i) {
+    size_t end = offsets[i + 1];
+    std::sort(rows.begin() + start, rows.begin() + end);
+    offsets[i] = neighbors.size();
+    for (size_t k = start; k < end; ++k) {
+      if (k > start && rows[k].first == rows[k - 1].first) continue;
+      neighbors.push_back(rows[k].first);
+      if (keepScores)
+        scores.push_back(rows[k].second);
+    }
+    start = end;
+  }
+  offsets[n_terms] = neighbors.size();
+  neighbors.shrink_to_fit();
+  scores.shrink_to_fit();
 }
 
-// returns true if neighbor exists in adjList[node]'s unordered_set
-bool AdjacencyList::hasNeighbor(int node, int neighbor) {
-  auto it = adjList.find(node);
-  if (it == adjList.end()) {
-    // node doesn't exist (bruh)
-    return false;
-  } 
-  const auto& neighbors = it->second;
-  bool neighborExists = neighbors.find(neighbor) != neighbors.end(); // O(1) 😏
-  return neighborExists;
-} 
+void AdjacencyList::addEdges(int n_terms, std::vector<EdgeBuffer>& buffers) {
+  bool keepScores = !scores.empty() || neighbors.empty();
+  EdgeBuffer existing;
+  existing.reserve(n_edges());
+  for (int i = 0; i < int(size()); ++i) {
+    for (size_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+      if (neighbors[k] > i)
+        existing.push_back({i, neighbors[k], keepScores ? scores[k] : 0.0});
+    }
+  }
+  buffers.push_back(std::move(existing));
+  build(n_terms, buffers, keepScores);
+}
 
+// returns true if neighbor is in node's (sorted) row
+bool AdjacencyList::hasNeighbor(int node, int neighbor) const {
+  if (node < 0 || node >= int(size()))
+    return false;
+  Span<int> row = getNeighbors(node);
+  return std::binary_search(row.begin(), row.end(), neighbor);
+}
@@ -8,31 +8,60 @@
 #ifndef AdjacencyList_h
 #define AdjacencyList_h
 
-#include <unordered_map>
-#include <unordered_set>
+#include <cstddef>
+#include <vector>
 
+// compressed sparse row graph: the neighbors of node i are
+// neighbors[offsets[i] .. offsets[i+1]), sorted and unique, with their edge
+// scores alongside. Edges are collected first and built in bulk.
 class AdjacencyList {
 public:
-  AdjacencyList(int n_terms) {
-    for (int i=0; i<n_terms; ++i){
-      adjList[i] = std::unordered_set<int>();
-    }
-  }
-  
-  void addNeighbor(int node, int neighbor);
-  bool hasNeighbor(int node, int neighbor);
-  
-  // return reference to adjList (used to initialize ClusterList)
-  const std::unordered_map<int, std::unordered_set<int>>& getAdjList() const {
-    return adjList;
-  }
-  
-  size_t size() const {
-    return adjList.size();
-  }
-  
+  // one edge as found while scoring; build() stores it in both directions
+  struct Edge {
+    int node;
+    int neighbor;
+    double score;
+  };
+  using EdgeBuffer = std::vector<Edge>;
+
+  // contiguous, sorted view of a node's neighbors (or their scores)
+  template <class T>
+  struct Span {
+    const T* first;
+    const T* last;
+    const T* begin() const { return first; };
+    const T* end() const { return last; };
+    size_t size() const { return size_t(last - first); };
+    bool empty() const { return first == last; };
+    const T& operator[](size_t k) const { return first[k]; };
+  };
+
+  AdjacencyList(int n_terms = 0): offsets(size_t(n_terms) + 1, 0) {}
+
+  // replaces the graph by the edges of all buffers (eg. one per thread);
+  // the buffers are consumed. keepScores = false leaves the scores out.
+  void build(int n_terms, std::vector<EdgeBuffer>& buffers, bool keepScores = true);
+  // adds edges to the existing graph, which may grow to n_terms nodes
+  void addEdges(int n_terms, std::vector<EdgeBuffer>& buffers);
+
+  Span<int> getNeighbors(int node) const {
+    return {neighbors.data() + offsets[node], neighbors.data() + offsets[node + 1]};
+  };
+  // empty unless the graph was built with scores
+  Span<double> getScores(int node) const {
+    if (scores.empty()) return {nullptr, nullptr};
+    return {scores.data() + offsets[node], scores.data() + offsets[node + 1]};
+  };
+  int degree(int node) const { return int(offsets[node + 1] - offsets[node]); };
+  bool hasNeighbor(int node, int neighbor) const; // binary search
+
+  size_t size() const { return offsets.size() - 1; };
+  size_t n_edges() const { return neighbors.size() / 2; }; // undirected
+
 private:
-  std::unordered_map<int, std::unordered_set<int>> adjList;
+  std::vector<size_t> offsets;
+  std::vector<int> neighbors;
+  std::vector<double> scores;
 };
 
 #endif /* AdjacencyList_h */
@@ -0,0 +1,534 @@
+//
+//  BootstrapStability.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+#include "BootstrapStability.h"
+#include "AdjacencyList.h"
+#include "DistanceMetric.h"
+#include "Parallel.h"
+#include "RichCluster.h"
+#include "SeedClustering.h"
+
+namespace {
+
+// independent, reproducible stream per replicate (splitmix64 of seed and r),
+// so results do not depend on the number of threads
+std::mt19937_64 replicateRng(uint64_t seed, int r) {
+  uint64_t z = seed + 0x9E3779B97F4A7C15ULL * (uint64_t(r) + 1);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return std::mt19937_64(z ^ (z >> 31));
+}
+
+// uniform in [0, n) by rejection (std::uniform_int_distribution differs between
+// standard libraries, this does not)
+int uniformIndex(std::mt19937_64& rng, int n) {
+  const uint64_t range = uint64_t(n);
+  const uint64_t limit = std::mt19937_64::max() - std::mt19937_64::max() % range;
+  uint64_t x;
+  do { x = rng(); } while (x >= limit);
+  return int(x % range);
+}
+
+// n draws with replacement, or round(fraction * n) distinct items without
+template <class Fn>
+void drawItems(std::mt19937_64& rng, int n, bool replace, double fraction, Fn&& pick) {
+  if (n <= 0) return;
+  if (replace) {
+    for (int k = 0; k < n; ++k)
+      pick(uniformIndex(rng, n));
+    return;
+  }
+  int keep = std::max(1, std::min(n, int(std::lround(fraction * n))));
+  std::vector<int> items(n);
+  for (int i = 0; i < n; ++i) items[i] = i;
+  for (int i = 0; i < keep; ++i) { // partial Fisher-Yates
+    std::swap(items[i], items[i + uniformIndex(rng, n - i)]);
+    pick(items[i]);
+  }
+}
+
+size_t packedIndex(int a, int b, int n) { // a < b
+  return size_t(a) * (2 * size_t(n) - a - 1) / 2 + size_t(b - a - 1);
+}
+
+} // namespace
+
+BootstrapStability::BootstrapStability(const std::vector<std::string>& geneIDs,
+                                       std::string distanceMetric, double distanceCutoff,
+                                       std::string linkageMethod, double linkageCutoff,
+                                       const Options& options):
+  n_terms(int(geneIDs.size())), geneSets(geneIDs), metricName(distanceMetric),
+  distanceCutoff(distanceCutoff), linkageMethod(linkageMethod), linkageCutoff(linkageCutoff),
+  clustering(options),
+  quantizer(0, noTerms, DistanceStorageSpec{"ondemand", "", options.precision},
+            DistanceMetric::scoreRange(distanceMetric)) {
+  DistanceMetric dm(metricName, distanceCutoff); // validates the name
+  dm.setTotalGeneCount(geneSets.universeSize());
+  edgeCutoff = quantizer.quantize(dm.getCutoff());
+  mergeCutoff = quantizer.quantize(linkageCutoff);
+
+  if (clustering.collapseDuplicates) {
+    rowOf = geneSets.collapseDuplicates();
+  } else {
+    rowOf.resize(n_terms);
+    for (int t = 0; t < n_terms; ++t) rowOf[t] = t;
+  }
+  n_rows = int(geneSets.n_terms());
+  rowTerms.resize(n_rows);
+  for (int t = 0; t < n_terms; ++t)
+    rowTerms[rowOf[t]].push_back(t);
+
+  // inverted index: rows of every gene
+  std::vector<std::vector<int>> rowsOf(geneSets.universeSize());
+  for (int t = 0; t < n_rows; ++t)
+    for (int g : geneSets.genes(t))
+      rowsOf[g].push_back(t);
+
+  // partners sharing a gene with i, then the shared genes by merge-walk
+  pairOffsets.assign(size_t(n_rows) + 1, 0);
+  geneOffsets.push_back(0);
+  std::vector<int> lastSeen(n_rows, -1);
+  std::vector<int> partners;
+  for (int i = 0; i < n_rows; ++i) {
+    partners.clear();
+    for (int g : geneSets.genes(i)) {
+      for (int j : rowsOf[g]) {
+        if (j > i && lastSeen[j] != i) {
+          lastSeen[j] = i;
+          partners.push_back(j);
+        }
+      }
+    }
+    std::sort(partners.begin(), partners.end());
+    for (int j : partners) {
+      const std::vector<int>& a = geneSets.genes(i);
+      const std::vector<int>& b = geneSets.genes(j);
+      size_t x = 0, y = 0;
+      while (x < a.size() && y < b.size()) {
+        if (a[x] < b[y]) ++x;
+        else if (b[y] < a[x]) ++y;
+        else { pairGenes.push_back(a[x]); ++x; ++y; }
+      }
+      pairPartner.push_back(j);
+      geneOffsets.push_back(pairGenes.size());
+      int common = int(geneOffsets.back() - geneOffsets[geneOffsets.size() - 2]);
+      baseScore.push_back(quantizer.quantize(
+        dm.computeDistance(common, geneSets.size(i), geneSets.size(j))));
+    }
+    pairOffsets[i + 1] = pairPartner.size();
+  }
+}
+
+double BootstrapStability::pairScore(const std::vector<double>& scores, int i, int j) const {
+  if (i > j) std::swap(i, j);
+  auto first = pairPartner.begin() + pairOffsets[i];
+  auto last = pairPartner.begin() + pairOffsets[i + 1];
+  auto it = std::lower_bound(first, last, j);
+  return (it != last && *it == j) ? scores[it - pairPartner.begin()] : 0.0;
+}
+
+// runs on worker threads: no R API in here
+std::vector<std::vector<int>> BootstrapStability::replicate(int r, const Settings& settings,
+                                                            std::vector<char>& included) const {
+  std::mt19937_64 rng = replicateRng(settings.seed, r);
+
+  // scores of the overlapping pairs under this replicate's sample
+  std::vector<double> reweighted;
+  const std::vector<double>* scores = &baseScore;
+  std::vector<char> rowIncluded(n_rows, 1);
+  if (settings.resample == "terms") {
+    // a term drawn more than once still counts once; a row is in when any of its terms is
+    included.assign(n_terms, 0);
+    drawItems(rng, n_terms, settings.replace, settings.fraction,
+              [&included](int t) { included[t] = 1; });
+    rowIncluded.assign(n_rows, 0);
+    for (int t = 0; t < n_terms; ++t)
+      if (included[t]) rowIncluded[rowOf[t]] = 1;
+  } else {
+    included.assign(n_terms, 1);
+    const int G = geneSets.universeSize();
+    std::vector<int> weight(G, 0);
+    drawItems(rng, G, settings.replace, settings.fraction, [&weight](int g) { weight[g]++; });
+    int totalGenes = 0;
+    for (int w : weight) totalGenes += w;
+    std::vector<int> size(n_rows, 0);
+    for (int t = 0; t < n_rows; ++t)
+      for (int g : geneSets.genes(t))
+        size[t] += weight[g];
+
+    DistanceMetric dm(metricName, distanceCutoff);
+    dm.setTotalGeneCount(totalGenes);
+    reweighted.assign(pairPartner.size(), 0.0);
+    for (int i = 0; i < n_rows; ++i) {
+      for (size_t p = pairOffsets[i]; p < pairOffsets[i + 1]; ++p) {
+        int common = 0;
+        for (size_t k = geneOffsets[p]; k < geneOffsets[p + 1]; ++k)
+          common += weight[pairGenes[k]];
+        if (common > 0)
+          reweighted[p] = quantizer.quantize(
+            dm.computeDistance(common, size[i], size[pairPartner[p]]));
+      }
+    }
+    scores = &reweighted;
+  }
+
+  // edges among the sampled rows; with knn only the knn best of every row
+  // (ties by index) as in richCluster::buildNearestGraph(), and seeds grow
+  // from each row's own picks unless they must be mutual
+  const int knn = std::max(0, clustering.knn);
+  std::vector<AdjacencyList::EdgeBuffer> edges(1);
+  std::vector<std::vector<int>> nearest(knn > 0 && !clustering.mutualKnn ? n_rows : 0);
+  if (knn > 0) {
+    using Scored = std::pair<double, int>;
+    std::vector<std::vector<Scored>> best(n_rows);
+    for (int i = 0; i < n_rows; ++i) {
+      if (!rowIncluded[i]) continue;
+      for (size_t p = pairOffsets[i]; p < pairOffsets[i + 1]; ++p) {
+        int j = pairPartner[p];
+        if (rowIncluded[j] && (*scores)[p] >= edgeCutoff) {
+          best[i].push_back({(*scores)[p], j});
+          best[j].push_back({(*scores)[p], i});
+        }
+      }
+    }
+    std::vector<std::vector<int>> picks(n_rows);
+    for (int i = 0; i < n_rows; ++i) {
+      std::vector<Scored>& candidates = best[i];
+      size_t k = std::min(candidates.size(), size_t(knn));
+      std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+                        [](const Scored& x, const Scored& y) {
+                          return x.first > y.first || (x.first == y.first && x.second < y.second);
+                        });
+      candidates.resize(k);
+      for (const Scored& pick : candidates) picks[i].push_back(pick.second);
+      std::sort(picks[i].begin(), picks[i].end());
+    }
+    for (int i = 0; i < n_rows; ++i) {
+      for (const Scored& pick : best[i]) {
+        int j = pick.second;
+        if (!clustering.mutualKnn)
+          edges[0].push_back({i, j, pick.first});
+        else if (i < j && std::binary_search(picks[j].begin(), picks[j].end(), i))
+          edges[0].push_back({i, j, pick.first});
+      }
+    }
+    if (!clustering.mutualKnn) nearest = std::move(picks);
+  } else {
+    for (int i = 0; i < n_rows; ++i) {
+      if (!rowIncluded[i]) continue;
+      for (size_t p = pairOffsets[i]; p < pairOffsets[i + 1]; ++p) {
+        if (rowIncluded[pairPartner[p]] && (*scores)[p] >= edgeCutoff)
+          edges[0].push_back({i, pairPartner[p], (*scores)[p]});
+      }
+    }
+  }
+  AdjacencyList adj;
+  adj.build(n_rows, edges, false);
+
+  // independent subproblems as in richCluster::clusterComponents(), or all
+  // sampled rows at once when that split is not exact (or turned off)
+  std::vector<std::vector<int>> groups;
+  std::vector<std::vector<int>> rowClusters;
+  if (clustering.components && (knn > 0 || mergeCutoff >= edgeCutoff)) {
+    std::vector<int> parent(n_rows);
+    for (int i = 0; i < n_rows; ++i) parent[i] = i;
+    auto find = [&parent](int x) {
+      while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+      }
+      return x;
+    };
+    for (int u = 0; u < n_rows; ++u) {
+      for (int v : adj.getNeighbors(u)) {
+        int ru = find(u), rv = find(v);
+        if (ru != rv) parent[std::max(ru, rv)] = std::min(ru, rv);
+      }
+    }
+    std::vector<int> groupOf(n_rows, -1);
+    for (int u = 0; u < n_rows; ++u) {
+      if (!rowIncluded[u]) continue;
+      if (adj.degree(u) == 0) {
+        rowClusters.push_back({u});
+        continue;
+      }
+      int root = find(u);
+      if (groupOf[root] < 0) {
+        groupOf[root] = int(groups.size());
+        groups.emplace_back();
+      }
+      groups[groupOf[root]].push_back(u);
+    }
+  } else {
+    groups.emplace_back();
+    for (int u = 0; u < n_rows; ++u)
+      if (rowIncluded[u]) groups.back().push_back(u);
+  }
+
+  for (const std::vector<int>& nodes : groups) {
+    const int m = int(nodes.size());
+    auto localIndex = [&nodes](int node) {
+      auto it = std::lower_bound(nodes.begin(), nodes.end(), node);
+      return (it != nodes.end() && *it == node) ? int(it - nodes.begin()) : -1;
+    };
+
+    std::vector<double> block;
+    std::function<double(int, int)> dist;
+    if (m <= 2048) {
+      block.assign(size_t(m) * m, 0.0);
+      for (int a = 0; a < m; ++a) {
+        block[size_t(a) * m + a] = richCluster::SAME_TERM_DISTANCE;
+        for (size_t p = pairOffsets[nodes[a]]; p < pairOffsets[nodes[a] + 1]; ++p) {
+          int b = localIndex(pairPartner[p]);
+          if (b < 0) continue;
+          block[size_t(a) * m + b] = (*scores)[p];
+          block[size_t(b) * m + a] = (*scores)[p];
+        }
+      }
+      dist = [&block, m](int a, int b) { return block[size_t(a) * m + b]; };
+    } else {
+      dist = [this, scores, &nodes](int a, int b) {
+        return a == b ? richCluster::SAME_TERM_DISTANCE : pairScore(*scores, nodes[a], nodes[b]);
+      };
+    }
+
+    std::vector<size_t> offsets(m + 1, 0);
+    std::vector<int> neighbors;
+    for (int a = 0; a < m; ++a) {
+      if (nearest.empty()) {
+        for (int v : adj.getNeighbors(nodes[a]))
+          neighbors.push_back(localIndex(v));
+      } else {
+        for (int v : nearest[nodes[a]]) {
+          int b = localIndex(v);
+          if (b >= 0) neighbors.push_back(b);
+        }
+      }
+      std::sort(neighbors.begin() + offsets[a], neighbors.end());
+      offsets[a + 1] = neighbors.size();
+    }
+
+    for (auto& [seed, cluster] : SeedClustering::cluster(offsets, neighbors, dist,
+                                                          linkageMethod, mergeCutoff)) {
+      std::vector<int> members;
+      members.reserve(cluster.size());
+      for (int a : cluster) members.push_back(nodes[a]);
+      rowClusters.push_back(std::move(members));
+    }
+  }
+
+  // back to the sampled terms of every row
+  std::vector<std::vector<int>> clusters;
+  clusters.reserve(rowClusters.size());
+  for (const std::vector<int>& rows : rowClusters) {
+    std::vector<int> members;
+    for (int row : rows)
+      for (int t : rowTerms[row])
+        if (included[t]) members.push_back(t);
+    std::sort(members.begin(), members.end());
+    clusters.push_back(std::move(members));
+  }
+  return clusters;
+}
+
+void BootstrapStability::run(const std::vector<std::vector<int>>& reference,
+                             const Settings& settings) {
+  if (settings.resample != "genes" && settings.resample != "terms")
+    throw std::invalid_argument("unsupported resampling: " + settings.resample);
+  if (settings.nReplicates < 1)
+    throw std::invalid_argument("need at least one replicate");
+  for (const std::vector<int>& cluster : reference)
+    for (int t : cluster)
+      if (t < 0 || t >= n_terms)
+        throw std::invalid_argument("reference cluster term index out of range");
+
+  used = settings;
+  referenceClusters = reference;
+  const int K = int(reference.size());
+  jaccardSum.assign(K, 0.0);
+  counted.assign(K, 0);
+  recovered.assign(K, 0);
+  dissolved.assign(K, 0);
+  coClustered.assign(size_t(n_terms) * (n_terms - 1) / 2, 0);
+  sampled.assign(n_terms, std::vector<uint64_t>((settings.nReplicates + 63) / 64, 0));
+
+  std::vector<std::vector<double>> bestMatch(settings.nReplicates);
+  parallelFor(settings.nReplicates, settings.threads, [&](int r, int) {
+    std::vector<char> included;
+    std::vector<std::vector<int>> clusters = replicate(r, settings, included);
+
+    // best Jaccard match of every reference cluster (restricted to the sample)
+    std::vector<std::vector<int>> memberOf(n_terms);
+    for (int d = 0; d < int(clusters.size()); ++d)
+      for (int t : clusters[d])
+        memberOf[t].push_back(d);
+    std::vector<double> best(K, -1.0); // -1: no term of the cluster sampled
+    std::vector<int> overlap(clusters.size(), 0);
+    std::vector<int> touched;
+    for (int k = 0; k < K; ++k) {
+      int sampledSize = 0;
+      for (int t : reference[k]) {
+        if (!included[t]) continue;
+        sampledSize++;
+        for (int d : memberOf[t])
+          if (overlap[d]++ == 0) touched.push_back(d);
+      }
+      if (sampledSize == 0) continue;
+      double bestJaccard = 0.0;
+      for (int d : touched) {
+        double jaccard = double(overlap[d]) / (sampledSize + int(clusters[d].size()) - overlap[d]);
+        bestJaccard = std::max(bestJaccard, jaccard);
+        overlap[d] = 0;
+      }
+      touched.clear();
+      best[k] = bestJaccard;
+    }
+
+    // pairs sharing a cluster (once, however many clusters they share)
+    std::vector<size_t> pairs;
+    for (const std::vector<int>& cluster : clusters)
+      for (size_t a = 0; a < cluster.size(); ++a)
+        for (size_t b = a + 1; b < cluster.size(); ++b)
+          pairs.push_back(packedIndex(cluster[a], cluster[b], n_terms));
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    bestMatch[r] = std::move(best);
+    std::lock_guard<std::mutex> lock(resultMutex);
+    for (size_t p : pairs)
+      coClustered[p]++;
+    for (int t = 0; t < n_terms; ++t)
+      if (included[t]) sampled[t][r / 64] |= uint64_t(1) << (r % 64);
+  });
+
+  // summed in replicate order, so the result does not depend on the threads
+  for (const std::vector<double>& best : bestMatch) {
+    for (int k = 0; k < K; ++k) {
+      if (best[k] < 0) continue;
+      jaccardSum[k] += best[k];
+      counted[k]++;
+      if (best[k] > 0.75) recovered[k]++;
+      if (best[k] <= 0.5) dissolved[k]++;
+    }
+  }
+}
+
+Rcpp::List BootstrapStability::export_r(const std::vector<std::string>& terms) const {
+  const int K = int(referenceClusters.size());
+  Rcpp::NumericVector stability(K), recoveredShare(K), dissolvedShare(K);
+  Rcpp::IntegerVector replicates(K);
+  for (int k = 0; k < K; ++k) {
+    replicates[k] = counted[k];
+    stability[k] = counted[k] ? jaccardSum[k] / counted[k] : NA_REAL;
+    recoveredShare[k] = counted[k] ? double(recovered[k]) / counted[k] : NA_REAL;
+    dissolvedShare[k] = counted[k] ? double(dissolved[k]) / counted[k] : NA_REAL;
+  }
+
+  // co-clustering frequency over the replicates that sampled both terms
+  auto bothSampled = [this](int a, int b) {
+    int n = 0;
+    for (size_t w = 0; w < sampled[a].size(); ++w)
+      n += int(std::bitset<64>(sampled[a][w] & sampled[b][w]).count());
+    return n;
+  };
+  Rcpp::NumericMatrix coClustering(n_terms, n_terms);
+  for (int a = 0; a < n_terms; ++a) {
+    int self = bothSampled(a, a);
+    coClustering(a, a) = self ? 1.0 : NA_REAL;
+    for (int b = a + 1; b < n_terms; ++b) {
+      int both = used.resample == "terms" ? bothSampled(a, b) : used.nReplicates;
+      double freq = both ? double(coClustered[packedIndex(a, b, n_terms)]) / both : NA_REAL;
+      coClustering(a, b) = freq;
+      coClustering(b, a) = freq;
+    }
+  }
+  coClustering.attr("dimnames") = Rcpp::List::create(terms, terms);
+
+  return Rcpp::List::create(
+    Rcpp::_["stability"] = Rcpp::DataFrame::create(
+      Rcpp::_["Stability"]  = stability,
+      Rcpp::_["Recovered"]  = recoveredShare,
+      Rcpp::_["Dissolved"]  = dissolvedShare,
+      Rcpp::_["Replicates"] = replicates
+    ),
+    Rcpp::_["co_clustering"] = coClustering,
+    Rcpp::_["n_replicates"]  = used.nReplicates,
+    Rcpp::_["resample"]      = used.resample,
+    Rcpp::_["replace"]       = used.replace
+  );
+}
+
+BootstrapStability::Settings BootstrapStability::settings(const Rcpp::List& options) {
+  Settings settings;
+  if (options.containsElementNamed("n_replicates"))
+    settings.nReplicates = Rcpp::as<int>(options["n_replicates"]);
+  if (options.containsElementNamed("resample"))
+    settings.resample = Rcpp::as<std::string>(options["resample"]);
+  if (options.containsElementNamed("replace"))
+    settings.replace = Rcpp::as<bool>(options["replace"]);
+  if (options.containsElementNamed("fraction"))
+    settings.fraction = Rcpp::as<double>(options["fraction"]);
+  if (options.containsElementNamed("seed"))
+    settings.seed = uint64_t(Rcpp::as<double>(options["seed"]));
+  if (options.containsElementNamed("threads"))
+    settings.threads = Rcpp::as<int>(options["threads"]);
+  return settings;
+}
+
+BootstrapStability::Options BootstrapStability::clusterOptions(const Rcpp::List& options) {
+  Options clustering;
+  if (options.containsElementNamed("precision"))
+    clustering.precision = Rcpp::as<std::string>(options["precision"]);
+  if (options.containsElementNamed("collapse_duplicates"))
+    clustering.collapseDuplicates = Rcpp::as<bool>(options["collapse_duplicates"]);
+  if (options.containsElementNamed("knn"))
+    clustering.knn = Rcpp::as<int>(options["knn"]);
+  if (options.containsElementNamed("mutual_knn"))
+    clustering.mutualKnn = Rcpp::as<bool>(options["mutual_knn"]);
+  if (options.containsElementNamed("components"))
+    clustering.components = Rcpp::as<bool>(options["components"]);
+  return clustering;
+}
+
+
+
+// the exported function to R
+// [[Rcpp::export]]
+Rcpp::List runBootstrapStability(Rcpp::CharacterVector terms,
+                                 Rcpp::CharacterVector geneIDs,
+                                 std::string distanceMetric, double distanceCutoff,
+                                 std::string linkageMethod, double linkageCutoff,
+                                 Rcpp::List referenceClusters,
+                                 Rcpp::List options = Rcpp::List::create()) {
+  try {
+    if (terms.size() != geneIDs.size())
+      throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+    std::vector<std::vector<int>> reference;
+    for (int k = 0; k < referenceClusters.size(); ++k)
+      reference.push_back(Rcpp::as<std::vector<int>>(referenceClusters[k]));
+
+    BootstrapStability::Settings settings = BootstrapStability::settings(options);
+    BootstrapStability BS(Rcpp::as<std::vector<std::string>>(geneIDs),
+                          distanceMetric, distanceCutoff, linkageMethod, linkageCutoff,
+                          BootstrapStability::clusterOptions(options));
+    Rcpp::Rcout << "Running " << settings.nReplicates << " " << settings.resample
+                << " resampling replicates..." << std::endl;
+    BS.run(reference, settings);
+    Rcpp::Rcout << "Done resampling." << std::endl;
+    return BS.export_r(Rcpp::as<std::vector<std::string>>(terms));
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
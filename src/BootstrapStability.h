@@ -0,0 +1,102 @@
+//
+//  BootstrapStability.h
+//  richCluster
+//
+
+#ifndef BootstrapStability_h
+#define BootstrapStability_h
+
+#include <Rcpp.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DistanceMatrix.h"
+#include "GeneSetList.h"
+
+// Resampling estimate of how stable clusters are: every replicate reweights
+// the genes (or drops terms), rescores only the pairs that share a gene and
+// reclusters with the same seed/merge rules as richCluster. Pairs without a
+// shared gene score 0 under every metric, so the shared genes of each
+// overlapping pair are all a replicate needs.
+class BootstrapStability {
+public:
+  // the richCluster options that change the clusters: score precision,
+  // duplicate collapsing, the kNN graph and the component split
+  struct Options {
+    std::string precision = "double";
+    bool collapseDuplicates = false;
+    int knn = 0;
+    bool mutualKnn = false;
+    bool components = true;
+  };
+
+  struct Settings {
+    int nReplicates = 200;
+    std::string resample = "genes"; // "genes" or "terms"
+    bool replace = true;            // bootstrap (with) or subsample (without replacement)
+    double fraction = 0.8;          // share of genes/terms kept when !replace
+    uint64_t seed = 1;              // replicate r draws from its own stream seed/r
+    int threads = 1;
+  };
+
+  BootstrapStability(const std::vector<std::string>& geneIDs,
+                     std::string distanceMetric, double distanceCutoff,
+                     std::string linkageMethod, double linkageCutoff,
+                     const Options& options);
+
+  // reference: the clusters (term indices) whose stability is estimated
+  void run(const std::vector<std::vector<int>>& reference, const Settings& settings);
+
+  // per reference cluster: mean best Jaccard match, share of replicates with a
+  // match > 0.75 (recovered) and <= 0.5 (dissolved); plus the co-clustering matrix
+  Rcpp::List export_r(const std::vector<std::string>& terms) const;
+
+  static Settings settings(const Rcpp::List& options);
+  static Options clusterOptions(const Rcpp::List& options);
+
+private:
+  int n_terms;
+  GeneSetList geneSets;
+  std::string metricName;
+  double distanceCutoff;
+  std::string linkageMethod;
+  double linkageCutoff;
+  Options clustering;
+
+  // rows are the unique gene sets when duplicates are collapsed (else the
+  // terms); scores and both cutoffs are rounded as the stored matrix rounds them
+  int n_rows;
+  std::vector<int> rowOf;
+  std::vector<std::vector<int>> rowTerms;
+  std::vector<std::string> noTerms;
+  DistanceMatrix quantizer; // "ondemand", so it holds no scores
+  double edgeCutoff;
+  double mergeCutoff;
+
+  // every pair sharing a gene: partners j > i of row i are
+  // pairPartner[pairOffsets[i] .. pairOffsets[i+1]) (sorted), the genes shared
+  // by pair p are pairGenes[geneOffsets[p] .. geneOffsets[p+1])
+  std::vector<size_t> pairOffsets;
+  std::vector<int> pairPartner;
+  std::vector<size_t> geneOffsets;
+  std::vector<int> pairGenes;
+  std::vector<double> baseScore; // score of every pair on the full data
+
+  // one replicate: sampled terms and the clusters (of terms) found on them
+  std::vector<std::vector<int>> replicate(int r, const Settings& settings,
+                                          std::vector<char>& included) const;
+  double pairScore(const std::vector<double>& scores, int i, int j) const;
+
+  // results
+  Settings used;
+  std::vector<std::vector<int>> referenceClusters;
+  std::vector<double> jaccardSum;
+  std::vector<int> counted, recovered, dissolved;
+  std::vector<int> coClustered;              // packed upper triangle
+  std::vector<std::vector<uint64_t>> sampled; // per term, bit r = sampled in replicate r
+  std::mutex resultMutex;
+};
+
+#endif /* BootstrapStability_h */
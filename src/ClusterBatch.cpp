@@ -0,0 +1,149 @@
+//
+//  ClusterBatch.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "ClusterBatch.h"
+#include "Parallel.h"
+
+void ClusterBatch::addJob(std::vector<std::string> terms, const std::vector<std::string>& geneIDs) {
+  if (terms.size() != geneIDs.size())
+    throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+  Job job;
+  job.n_terms = int(terms.size());
+  job.terms = std::move(terms);
+  job.geneSets.reserve(geneIDs.size());
+  for (const std::string& geneString : geneIDs)
+    job.geneSets.push_back(genes.intern(geneString));
+  jobs.push_back(std::move(job));
+}
+
+// runs on a worker thread (or on the main one with all threads): no R API
+void ClusterBatch::runJob(Job& job, const richCluster::RunSettings& shared) {
+  auto start = std::chrono::steady_clock::now();
+  GeneSetList geneSets(std::move(job.geneSets), genes.size());
+  std::vector<int> rowOf;
+  if (collapseDuplicates)
+    rowOf = geneSets.collapseDuplicates();
+  job.result.reset(new richCluster(std::move(job.terms), std::move(geneSets),
+                                   distanceMetric, distanceCutoff,
+                                   linkageMethod, linkageCutoff, storage,
+                                   {}, std::move(rowOf)));
+  richCluster::RunSettings settings = shared;
+  settings.threads = job.threads;
+  settings.verbose = false;
+  job.result->run(settings);
+  job.n_edges = job.result->n_edges();
+  if (!exportDistances)
+    job.result->releaseDistances();
+  job.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ClusterBatch::run(const richCluster::RunSettings& settings, bool exportDistances) {
+  this->exportDistances = exportDistances;
+  const int threads = resolveThreads(settings.threads);
+
+  // pairs scored per job; a job above 1/threads of the total would leave the
+  // other threads idle if packed, so it is split instead
+  double totalWork = 0.0;
+  std::vector<double> work(jobs.size());
+  for (size_t j=0; j<jobs.size(); ++j) {
+    work[j] = double(jobs[j].n_terms) * double(jobs[j].n_terms);
+    totalWork += work[j];
+  }
+  std::vector<int> split, packed;
+  for (size_t j=0; j<jobs.size(); ++j) {
+    if (threads > 1 && work[j] * threads > totalWork) {
+      jobs[j].threads = threads;
+      split.push_back(int(j));
+    } else {
+      jobs[j].threads = 1;
+      packed.push_back(int(j));
+    }
+  }
+  // biggest packed jobs first so the threads finish together
+  std::sort(packed.begin(), packed.end(), [&work](int a, int b) { return work[a] > work[b]; });
+
+  Rcpp::Rcout << "Clustering " << jobs.size() << " jobs on " << threads << " threads ("
+              << split.size() << " split, " << packed.size() << " packed)..." << std::endl;
+  for (int j : split)
+    runJob(jobs[j], settings);
+  parallelFor(int(packed.size()), threads, [&](int task, int) {
+    runJob(jobs[packed[task]], settings);
+  });
+  Rcpp::Rcout << "Done clustering jobs." << std::endl;
+}
+
+Rcpp::List ClusterBatch::export_r() const {
+  const int n = int(jobs.size());
+  Rcpp::List results(n);
+  Rcpp::IntegerVector jobColumn(n), termsColumn(n), genesColumn(n), clustersColumn(n), threadsColumn(n);
+  Rcpp::NumericVector edgesColumn(n), secondsColumn(n);
+  for (int j=0; j<n; ++j) {
+    const Job& job = jobs[j];
+    results[j] = job.result->export_result(exportDistances);
+    jobColumn[j] = j + 1;
+    termsColumn[j] = job.n_terms;
+    genesColumn[j] = job.result->n_genes();
+    edgesColumn[j] = double(job.n_edges);
+    clustersColumn[j] = int(job.result->n_clusters());
+    threadsColumn[j] = job.threads;
+    secondsColumn[j] = job.seconds;
+  }
+  return Rcpp::List::create(
+    Rcpp::_["results"] = results,
+    Rcpp::_["stats"] = Rcpp::DataFrame::create(
+      Rcpp::_["Job"]      = jobColumn,
+      Rcpp::_["Terms"]    = termsColumn,
+      Rcpp::_["Genes"]    = genesColumn,
+      Rcpp::_["Edges"]    = edgesColumn,
+      Rcpp::_["Clusters"] = clustersColumn,
+      Rcpp::_["Threads"]  = threadsColumn,
+      Rcpp::_["Seconds"]  = secondsColumn
+    )
+  );
+}
+
+
+
+// the exported function to R
+// jobs: list of list(terms = , geneIDs = ); options as for runRichCluster()
+// (threads, precision, components, export_distances, collapse_duplicates,
+// knn, mutual_knn; storage is memory, or ondemand for a kNN graph)
+// [[Rcpp::export]]
+Rcpp::List runRichClusterBatch(Rcpp::List jobs,
+                               std::string distanceMetric, double distanceCutoff,
+                               std::string linkageMethod, double linkageCutoff,
+                               Rcpp::List options = Rcpp::List::create()) {
+  try {
+    DistanceStorageSpec storage;
+    if (options.containsElementNamed("precision"))
+      storage.precision = Rcpp::as<std::string>(options["precision"]);
+    richCluster::RunSettings settings = richCluster::runSettings(options);
+    if (settings.knn > 0)
+      storage.backend = "ondemand";
+    bool exportDistances = !options.containsElementNamed("export_distances")
+      || Rcpp::as<bool>(options["export_distances"]);
+
+    bool collapseDuplicates = options.containsElementNamed("collapse_duplicates")
+      && Rcpp::as<bool>(options["collapse_duplicates"]);
+
+    ClusterBatch batch(distanceMetric, distanceCutoff, linkageMethod, linkageCutoff,
+                       storage, collapseDuplicates);
+    for (int j=0; j<jobs.size(); ++j) {
+      Rcpp::List job = jobs[j];
+      batch.addJob(Rcpp::as<std::vector<std::string>>(job["terms"]),
+                   Rcpp::as<std::vector<std::string>>(job["geneIDs"]));
+    }
+    batch.run(settings, exportDistances);
+    return batch.export_r();
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,67 @@
+//
+//  ClusterBatch.h
+//  richCluster
+//
+
+#ifndef ClusterBatch_h
+#define ClusterBatch_h
+
+#include <Rcpp.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GeneSetList.h"
+#include "RichCluster.h"
+
+// Many independent clusterings (eg. one per contrast of a study) in one call.
+// Gene strings are interned once into a shared dictionary, then the jobs run
+// on one pool of threads: a job bigger than its share of the total work gets
+// every thread for itself (its scoring and components are split internally),
+// the rest are packed one job per thread. Only the export touches R.
+class ClusterBatch {
+public:
+  ClusterBatch(std::string distanceMetric, double distanceCutoff,
+               std::string linkageMethod, double linkageCutoff,
+               const DistanceStorageSpec& storage = DistanceStorageSpec(),
+               bool collapseDuplicates = false):
+  distanceMetric(distanceMetric), distanceCutoff(distanceCutoff),
+  linkageMethod(linkageMethod), linkageCutoff(linkageCutoff), storage(storage),
+  collapseDuplicates(collapseDuplicates) {};
+
+  // interns the job's genes; main thread only
+  void addJob(std::vector<std::string> terms, const std::vector<std::string>& geneIDs);
+  // settings.threads <= 0 uses every hardware thread (the other settings
+  // apply to every job); exportDistances = false frees every job's scores as
+  // soon as it is clustered
+  void run(const richCluster::RunSettings& settings, bool exportDistances = true);
+
+  // results: one runRichCluster()-like list per job; stats: one row per job
+  Rcpp::List export_r() const;
+
+private:
+  struct Job {
+    std::vector<std::string> terms;
+    std::vector<std::vector<int>> geneSets; // ids in the shared dictionary
+    std::unique_ptr<richCluster> result;
+    int n_terms = 0;
+    int threads = 1;
+    double seconds = 0.0;
+    size_t n_edges = 0;
+  };
+
+  void runJob(Job& job, const richCluster::RunSettings& shared);
+
+  std::string distanceMetric;
+  double distanceCutoff;
+  std::string linkageMethod;
+  double linkageCutoff;
+  DistanceStorageSpec storage;
+  bool collapseDuplicates; // score and cluster identical gene sets once per job
+
+  GeneDictionary genes;
+  std::vector<Job> jobs;
+  bool exportDistances = true;
+};
+
+#endif /* ClusterBatch_h */
@@ -0,0 +1,232 @@
+//
+//  ClusterComparison.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "ClusterComparison.h"
+
+namespace {
+double choose2(double n) { return n * (n - 1) / 2; }
+}
+
+ClusterComparison::Side ClusterComparison::group(const std::vector<int>& termIds,
+                                                 const std::vector<int>& labels) {
+  Side side;
+  std::unordered_map<int, int> clusterOf;
+  for (size_t p=0; p<labels.size(); ++p) {
+    auto it = clusterOf.emplace(labels[p], int(side.labels.size())).first;
+    if (it->second == int(side.labels.size())) {
+      side.labels.push_back(labels[p]);
+      side.members.emplace_back();
+    }
+    side.members[it->second].push_back(termIds[p]);
+  }
+  for (auto& members : side.members) {
+    std::sort(members.begin(), members.end());
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+  }
+  return side;
+}
+
+ClusterComparison::ClusterComparison(const std::vector<std::string>& termsA,
+                                     const std::vector<int>& labelsA,
+                                     const std::vector<std::string>& termsB,
+                                     const std::vector<int>& labelsB) {
+  if (termsA.size() != labelsA.size() || termsB.size() != labelsB.size())
+    throw std::invalid_argument("every membership needs one term and one cluster");
+  std::unordered_map<std::string, int> termIndex;
+  auto intern = [&termIndex](const std::vector<std::string>& terms) {
+    std::vector<int> ids(terms.size());
+    for (size_t p=0; p<terms.size(); ++p)
+      ids[p] = termIndex.emplace(terms[p], int(termIndex.size())).first->second;
+    return ids;
+  };
+  A = group(intern(termsA), labelsA);
+  B = group(intern(termsB), labelsB);
+  const int nTerms = int(termIndex.size());
+
+  // term -> clusters of B
+  std::vector<size_t> offsets(size_t(nTerms) + 1, 0);
+  for (const auto& members : B.members)
+    for (int t : members) ++offsets[t + 1];
+  for (int t=0; t<nTerms; ++t) offsets[t + 1] += offsets[t];
+  std::vector<int> clustersOf(offsets[nTerms]);
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (int b=0; b<int(B.members.size()); ++b)
+      for (int t : B.members[b]) clustersOf[fill[t]++] = b;
+  }
+
+  std::vector<char> inA(nTerms, 0);
+  for (const auto& members : A.members)
+    for (int t : members) inA[t] = 1;
+  for (int t=0; t<nTerms; ++t) {
+    const bool inB = offsets[t + 1] > offsets[t];
+    sharedTerms += inA[t] && inB;
+    onlyA += inA[t] && !inB;
+    onlyB += !inA[t] && inB;
+  }
+
+  // sparse rows of the overlap table, one cluster of A at a time
+  std::vector<int> overlap(B.members.size(), 0);
+  std::vector<int> touched;
+  for (int a=0; a<int(A.members.size()); ++a) {
+    for (int t : A.members[a]) {
+      for (size_t p=offsets[t]; p<offsets[t + 1]; ++p)
+        if (overlap[clustersOf[p]]++ == 0) touched.push_back(clustersOf[p]);
+    }
+    std::sort(touched.begin(), touched.end());
+    for (int b : touched) {
+      cells.push_back({a, b, overlap[b]});
+      overlap[b] = 0;
+    }
+    touched.clear();
+  }
+}
+
+double ClusterComparison::jaccard(const Cell& cell) const {
+  const double sizeA = double(A.members[cell.a].size()), sizeB = double(B.members[cell.b].size());
+  return cell.overlap / (sizeA + sizeB - cell.overlap);
+}
+
+std::vector<std::pair<int, int>> ClusterComparison::bestMatches(bool ofA) const {
+  const Side& side = ofA ? A : B;
+  std::vector<std::pair<int, int>> best(side.members.size(), {-1, 0}); // (cell, partner)
+  std::vector<double> bestScore(side.members.size(), -1.0);
+  for (size_t c=0; c<cells.size(); ++c) {
+    const int self = ofA ? cells[c].a : cells[c].b;
+    const int partner = ofA ? cells[c].b : cells[c].a;
+    const double score = jaccard(cells[c]);
+    // ties go to the partner listed first
+    if (score > bestScore[self] || (score == bestScore[self] && partner < best[self].second)) {
+      bestScore[self] = score;
+      best[self] = {int(c), partner};
+    }
+  }
+  return best;
+}
+
+double ClusterComparison::adjustedRandIndex() const {
+  std::vector<double> rowSums(A.members.size(), 0.0), colSums(B.members.size(), 0.0);
+  double index = 0.0, total = 0.0;
+  for (const Cell& cell : cells) {
+    index += choose2(cell.overlap);
+    rowSums[cell.a] += cell.overlap;
+    colSums[cell.b] += cell.overlap;
+    total += cell.overlap;
+  }
+  double rows = 0.0, cols = 0.0;
+  for (double n : rowSums) rows += choose2(n);
+  for (double n : colSums) cols += choose2(n);
+  if (total < 2)
+    return NA_REAL;
+  const double expected = rows * cols / choose2(total);
+  const double maximum = (rows + cols) / 2;
+  if (maximum == expected)
+    return 1.0; // both sides put every shared term together (or apart)
+  return (index - expected) / (maximum - expected);
+}
+
+double ClusterComparison::normalizedMutualInformation() const {
+  std::vector<double> rowSums(A.members.size(), 0.0), colSums(B.members.size(), 0.0);
+  double total = 0.0;
+  for (const Cell& cell : cells) {
+    rowSums[cell.a] += cell.overlap;
+    colSums[cell.b] += cell.overlap;
+    total += cell.overlap;
+  }
+  if (total == 0)
+    return NA_REAL;
+  auto entropy = [total](const std::vector<double>& sums) {
+    double h = 0.0;
+    for (double n : sums)
+      if (n > 0) h -= n / total * std::log(n / total);
+    return h;
+  };
+  const double hA = entropy(rowSums), hB = entropy(colSums);
+  if (hA + hB == 0)
+    return 1.0; // one cluster on each side
+  double mutual = 0.0;
+  for (const Cell& cell : cells)
+    mutual += cell.overlap / total * std::log(total * cell.overlap / (rowSums[cell.a] * colSums[cell.b]));
+  return std::max(0.0, 2 * mutual / (hA + hB));
+}
+
+Rcpp::DataFrame ClusterComparison::exportMatches(bool ofA) const {
+  const Side& side = ofA ? A : B;
+  const Side& other = ofA ? B : A;
+  const std::vector<std::pair<int, int>> best = bestMatches(ofA);
+  const int n = int(side.members.size());
+  Rcpp::IntegerVector clusterColumn(n), sizeColumn(n), matchColumn(n), overlapColumn(n);
+  Rcpp::NumericVector jaccardColumn(n);
+  for (int c=0; c<n; ++c) {
+    clusterColumn[c] = side.labels[c];
+    sizeColumn[c] = int(side.members[c].size());
+    if (best[c].first < 0) {
+      matchColumn[c] = NA_INTEGER;
+      overlapColumn[c] = 0;
+      jaccardColumn[c] = 0.0;
+    } else {
+      const Cell& cell = cells[best[c].first];
+      matchColumn[c] = other.labels[best[c].second];
+      overlapColumn[c] = cell.overlap;
+      jaccardColumn[c] = jaccard(cell);
+    }
+  }
+  return Rcpp::DataFrame::create(
+    Rcpp::_["Cluster"]   = clusterColumn,
+    Rcpp::_["Size"]      = sizeColumn,
+    Rcpp::_["BestMatch"] = matchColumn,
+    Rcpp::_["Overlap"]   = overlapColumn,
+    Rcpp::_["Jaccard"]   = jaccardColumn
+  );
+}
+
+Rcpp::List ClusterComparison::export_r() const {
+  const int n = int(cells.size());
+  Rcpp::IntegerVector aColumn(n), bColumn(n), overlapColumn(n);
+  Rcpp::NumericVector jaccardColumn(n);
+  for (int c=0; c<n; ++c) {
+    aColumn[c] = A.labels[cells[c].a];
+    bColumn[c] = B.labels[cells[c].b];
+    overlapColumn[c] = cells[c].overlap;
+    jaccardColumn[c] = jaccard(cells[c]);
+  }
+  return Rcpp::List::create(
+    Rcpp::_["overlaps"] = Rcpp::DataFrame::create(
+      Rcpp::_["ClusterA"] = aColumn,
+      Rcpp::_["ClusterB"] = bColumn,
+      Rcpp::_["Overlap"]  = overlapColumn,
+      Rcpp::_["Jaccard"]  = jaccardColumn
+    ),
+    Rcpp::_["best_a"] = exportMatches(true),
+    Rcpp::_["best_b"] = exportMatches(false),
+    Rcpp::_["ari"] = adjustedRandIndex(),
+    Rcpp::_["nmi"] = normalizedMutualInformation(),
+    Rcpp::_["shared_terms"] = double(sharedTerms),
+    Rcpp::_["terms_only_a"] = double(onlyA),
+    Rcpp::_["terms_only_b"] = double(onlyB)
+  );
+}
+
+
+
+// the exported function to R: memberships as parallel (term, cluster) vectors,
+// eg. the Term and Cluster columns of two cluster_df
+// [[Rcpp::export]]
+Rcpp::List compareClusterMemberships(std::vector<std::string> termsA, std::vector<int> clustersA,
+                                     std::vector<std::string> termsB, std::vector<int> clustersB) {
+  try {
+    ClusterComparison comparison(termsA, clustersA, termsB, clustersB);
+    return comparison.export_r();
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,57 @@
+//
+//  ClusterComparison.h
+//  richCluster
+//
+
+#ifndef ClusterComparison_h
+#define ClusterComparison_h
+
+#include <Rcpp.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Correspondence between two clusterings of (partly) the same terms, eg.
+// two contrasts, parameter settings or package versions, or richCluster
+// against DAVID. Terms are matched by name through one hash index; the
+// cluster x cluster overlap table is built sparsely through a term ->
+// clusters index of the second clustering, so the whole comparison is
+// linear in the total membership (times the clusters a term is in).
+// Best matches use Jaccard; the adjusted Rand index and normalized mutual
+// information are taken over the contingency table of the terms clustered
+// on both sides (exact for partitions, membership-weighted when clusters
+// overlap).
+class ClusterComparison {
+public:
+  // one (term, cluster label) pair per membership, for each side; repeated
+  // pairs count once
+  ClusterComparison(const std::vector<std::string>& termsA, const std::vector<int>& labelsA,
+                    const std::vector<std::string>& termsB, const std::vector<int>& labelsB);
+
+  double adjustedRandIndex() const;
+  double normalizedMutualInformation() const; // arithmetic-mean normalization
+
+  // overlaps (sparse table), best matches of each side, ari, nmi and term counts
+  Rcpp::List export_r() const;
+
+private:
+  struct Side {
+    std::vector<int> labels;               // original label of every cluster
+    std::vector<std::vector<int>> members; // term ids of every cluster, ascending
+  };
+  struct Cell {
+    int a, b, overlap;
+  };
+
+  static Side group(const std::vector<int>& termIds, const std::vector<int>& labels);
+  // best Jaccard match in other of every cluster of side (first == -1: none)
+  std::vector<std::pair<int, int>> bestMatches(bool ofA) const;
+  double jaccard(const Cell& cell) const;
+  Rcpp::DataFrame exportMatches(bool ofA) const;
+
+  Side A, B;
+  std::vector<Cell> cells;   // by a, then b; overlap > 0
+  size_t sharedTerms = 0, onlyA = 0, onlyB = 0;
+};
+
+#endif /* ClusterComparison_h */
@@ -0,0 +1,169 @@
+//
+//  ClusterJob.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ClusterJob.h"
+
+ClusterJob::ClusterJob(std::unique_ptr<richCluster> rc, richCluster::RunSettings settings,
+                       bool exportDistances):
+  rc(std::move(rc)), control(std::make_shared<RunControl>()),
+  exportDistances(exportDistances), started(std::chrono::steady_clock::now()) {
+  this->rc->setRunControl(control);
+  settings.verbose = false; // no Rcout off the main thread
+  worker = std::thread([this, settings]() {
+    std::string failure;
+    RunControl::Phase last = RunControl::Phase::Done;
+    try {
+      this->rc->run(settings);
+    } catch (const RunCancelled&) {
+      last = RunControl::Phase::Cancelled;
+    } catch (const std::exception& e) {
+      last = RunControl::Phase::Failed;
+      failure = e.what();
+    } catch (...) {
+      last = RunControl::Phase::Failed;
+      failure = "unknown C++ exception";
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    error = failure;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    control->finish(last);
+    running = false;
+    stopped.notify_all();
+  });
+}
+
+ClusterJob::~ClusterJob() {
+  control->cancel();
+  if (worker.joinable())
+    worker.join();
+}
+
+bool ClusterJob::wait(double seconds) {
+  auto deadline = std::chrono::steady_clock::now()
+    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(std::max(0.0, seconds)));
+  std::unique_lock<std::mutex> lock(mutex);
+  while (running) {
+    if (seconds >= 0 && std::chrono::steady_clock::now() >= deadline)
+      return false;
+    stopped.wait_for(lock, std::chrono::milliseconds(100));
+    lock.unlock();
+    Rcpp::checkUserInterrupt();
+    lock.lock();
+  }
+  return true;
+}
+
+Rcpp::List ClusterJob::progress() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  const double elapsed = running
+    ? std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count()
+    : seconds;
+  const double fraction = control->fraction();
+  return Rcpp::List::create(
+    Rcpp::_["phase"]    = RunControl::phaseName(control->phase()),
+    Rcpp::_["fraction"] = std::isnan(fraction) ? NA_REAL : fraction,
+    Rcpp::_["done"]     = double(control->done()),
+    Rcpp::_["total"]    = double(control->total()),
+    Rcpp::_["seconds"]  = elapsed,
+    Rcpp::_["finished"] = !running,
+    Rcpp::_["error"]    = error.empty() ? Rcpp::CharacterVector::create(NA_STRING)
+                                        : Rcpp::CharacterVector::create(error)
+  );
+}
+
+void ClusterJob::finished() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running)
+      throw std::runtime_error("the clustering job is still running");
+  }
+  if (worker.joinable())
+    worker.join();
+  switch (control->phase()) {
+    case RunControl::Phase::Cancelled:
+      throw std::runtime_error("the clustering job was cancelled");
+    case RunControl::Phase::Failed:
+      throw std::runtime_error("the clustering job failed: " + error);
+    default:
+      break;
+  }
+  if (!rc)
+    throw std::runtime_error("the clustering job was already collected as a session");
+}
+
+Rcpp::List ClusterJob::result() {
+  finished();
+  return rc->export_result(exportDistances);
+}
+
+std::unique_ptr<richCluster> ClusterJob::release() {
+  finished();
+  return std::move(rc);
+}
+
+SEXP ClusterJob::start(std::unique_ptr<richCluster> rc, const Rcpp::List& options) {
+  bool exportDistances = !options.containsElementNamed("export_distances")
+    || Rcpp::as<bool>(options["export_distances"]);
+  Rcpp::XPtr<ClusterJob> job(new ClusterJob(std::move(rc), richCluster::runSettings(options),
+                                            exportDistances), true);
+  job.attr("class") = "richCluster_job";
+  return job;
+}
+
+
+
+// the exported functions to R: a job from runRichCluster(options = list(async = TRUE))
+static Rcpp::XPtr<ClusterJob> jobPtr(SEXP job) {
+  Rcpp::XPtr<ClusterJob> ptr(job);
+  if (ptr.get() == nullptr)
+    Rcpp::stop("clustering job is no longer valid (was it saved and reloaded?)");
+  return ptr;
+}
+
+// list(phase, fraction, done, total, seconds, finished, error); fraction is
+// NA while merging, whose number of passes is unknown
+// [[Rcpp::export]]
+Rcpp::List jobProgress(SEXP job) {
+  return jobPtr(job)->progress();
+}
+
+// [[Rcpp::export]]
+void jobCancel(SEXP job) {
+  jobPtr(job)->cancel();
+}
+
+// TRUE once the job finished; seconds < 0 waits for it
+// [[Rcpp::export]]
+bool jobWait(SEXP job, double seconds = -1) {
+  return jobPtr(job)->wait(seconds);
+}
+
+// [[Rcpp::export]]
+Rcpp::List jobResult(SEXP job) {
+  Rcpp::XPtr<ClusterJob> ptr = jobPtr(job);
+  try {
+    return ptr->result();
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// the finished richCluster as a cluster session (see createClusterSession)
+// [[Rcpp::export]]
+SEXP jobSession(SEXP job) {
+  Rcpp::XPtr<ClusterJob> ptr = jobPtr(job);
+  try {
+    return Rcpp::XPtr<richCluster>(ptr->release().release(), true);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
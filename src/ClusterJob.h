@@ -0,0 +1,63 @@
+//
+//  ClusterJob.h
+//  richCluster
+//
+
+#ifndef ClusterJob_h
+#define ClusterJob_h
+
+#include <Rcpp.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "RichCluster.h"
+#include "RunControl.h"
+
+// One richCluster run in the background: the richCluster is built (and its
+// storage planned) on the main thread, then run() continues on a thread of
+// its own, quietly, with its own pool of settings.threads workers. The main
+// thread polls progress(), may cancel() it and collects the result once it
+// finished; only those calls touch R.
+class ClusterJob {
+public:
+  ClusterJob(std::unique_ptr<richCluster> rc, richCluster::RunSettings settings,
+             bool exportDistances);
+  // cancels a job still running and waits for it to stop
+  ~ClusterJob();
+
+  // waits up to `seconds` (< 0: until it finished), checking for user
+  // interrupts meanwhile; an interrupt stops the wait, not the job
+  bool wait(double seconds);
+  void cancel() { control->cancel(); };
+  Rcpp::List progress() const;
+
+  // the runRichCluster() list of a finished job; stops if it failed or was cancelled
+  Rcpp::List result();
+  // hands the clustered richCluster over as a session; the job keeps its progress only
+  std::unique_ptr<richCluster> release();
+
+  // starts a richCluster::create()d run with the R options of runRichCluster();
+  // the external pointer returned has class "richCluster_job"
+  static SEXP start(std::unique_ptr<richCluster> rc, const Rcpp::List& options);
+
+private:
+  void finished(); // joins the worker; throws unless the run completed
+
+  std::unique_ptr<richCluster> rc;
+  std::shared_ptr<RunControl> control;
+  bool exportDistances;
+  std::chrono::steady_clock::time_point started;
+
+  mutable std::mutex mutex;
+  std::condition_variable stopped;
+  bool running = true; // guarded by mutex
+  std::string error;   // why the run failed (written before running = false)
+  double seconds = 0.0;
+  std::thread worker;
+};
+
+#endif /* ClusterJob_h */
@@ -16,7 +16,7 @@ public:
   using Cluster = std::unordered_set<int>;
   using ClusterIt = std::list<Cluster>::iterator;
   
-  ClusterList(std::vector<std::string>& terms): terms(terms) {};
+  ClusterList(const std::vector<std::string>& terms): terms(terms) {};
   void addCluster(Cluster cluster) {clusterList.push_back(cluster);};
   void removeCluster(ClusterIt it) {clusterList.erase(it);};
   void mergeClusters(ClusterIt it1, ClusterIt it2) {
@@ -25,6 +25,10 @@ public:
     clusterList.erase(it2);
   }
   std::list<Cluster>& getList() {return clusterList;};
+  const std::list<Cluster>& getList() const {return clusterList;};
+  void appendTerms(const std::vector<std::string>& newTerms) {
+    terms.insert(terms.end(), newTerms.begin(), newTerms.end());
+  };
   Rcpp::DataFrame export_r() const;
   void deduplicate();
   size_t size() const { return clusterList.size(); }
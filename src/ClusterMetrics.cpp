@@ -0,0 +1,139 @@
+//
+//  ClusterMetrics.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <chrono>
+#include <stdexcept>
+
+#include "ClusterMetrics.h"
+
+ClusterMetrics::ClusterMetrics(std::vector<std::string> terms,
+                               const std::vector<std::string>& geneIDs,
+                               bool collapseDuplicates):
+  terms(std::move(terms)), geneSets(geneIDs) {
+  if (this->terms.size() != geneIDs.size())
+    throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+  if (collapseDuplicates)
+    rowOf = geneSets.collapseDuplicates();
+}
+
+void ClusterMetrics::run(const std::vector<Metric>& metrics, const std::string& linkageMethod,
+                         const DistanceStorageSpec& storage,
+                         const richCluster::RunSettings& settings,
+                         const ResourcePlanner::Settings& planning, bool exportDistances) {
+  this->metrics = metrics;
+  this->exportDistances = exportDistances;
+
+  auto start = std::chrono::steady_clock::now();
+  counts = std::make_shared<const IntersectionCounts>(geneSets, settings.threads);
+  countSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  Rcpp::Rcout << "Counted " << counts->n_pairs() << " overlapping pairs of "
+              << geneSets.n_terms() << " gene sets in " << countSeconds << " s." << std::endl;
+
+  richCluster::RunSettings quiet = settings;
+  quiet.verbose = false;
+  for (const Metric& metric : metrics) {
+    start = std::chrono::steady_clock::now();
+    DistanceStorageSpec spec = storage;
+    if (spec.backend == "auto") {
+      ResourcePlanner planner(geneSets, metric.distanceMetric, metric.distanceCutoff,
+                              planning);
+      spec = planner.choose("auto");
+    }
+    std::unique_ptr<richCluster> RC(new richCluster(terms, geneSets,
+                                                    metric.distanceMetric, metric.distanceCutoff,
+                                                    linkageMethod, metric.linkageCutoff,
+                                                    spec, {}, rowOf));
+    RC->setIntersectionCounts(counts);
+    RC->run(quiet);
+    edges.push_back(RC->n_edges());
+    if (!exportDistances)
+      RC->releaseDistances();
+    seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    Rcpp::Rcout << metric.distanceMetric << ": " << edges.back() << " edges, "
+                << RC->n_clusters() << " clusters in " << seconds.back() << " s." << std::endl;
+    results.push_back(std::move(RC));
+    Rcpp::checkUserInterrupt();
+  }
+}
+
+Rcpp::List ClusterMetrics::export_r(bool keepCounts) const {
+  const int n = int(results.size());
+  Rcpp::List out(n);
+  Rcpp::CharacterVector metricColumn(n);
+  Rcpp::NumericVector cutoffColumn(n), edgesColumn(n), secondsColumn(n);
+  Rcpp::IntegerVector clustersColumn(n);
+  for (int k=0; k<n; ++k) {
+    out[k] = results[k]->export_result(exportDistances);
+    metricColumn[k] = metrics[k].distanceMetric;
+    cutoffColumn[k] = metrics[k].distanceCutoff;
+    edgesColumn[k] = double(edges[k]);
+    clustersColumn[k] = int(results[k]->n_clusters());
+    secondsColumn[k] = seconds[k];
+  }
+  out.attr("names") = metricColumn;
+
+  std::vector<int> rows = rowOf;
+  if (rows.empty())
+    for (int t=0; t<int(terms.size()); ++t) rows.push_back(t);
+  return Rcpp::List::create(
+    Rcpp::_["results"] = out,
+    Rcpp::_["stats"] = Rcpp::DataFrame::create(
+      Rcpp::_["Metric"]         = metricColumn,
+      Rcpp::_["DistanceCutoff"] = cutoffColumn,
+      Rcpp::_["Edges"]          = edgesColumn,
+      Rcpp::_["Clusters"]       = clustersColumn,
+      Rcpp::_["Seconds"]        = secondsColumn
+    ),
+    Rcpp::_["count_seconds"] = countSeconds,
+    Rcpp::_["counts"] = keepCounts ? Rcpp::RObject(counts->export_r(terms, rows))
+                                   : Rcpp::RObject(R_NilValue)
+  );
+}
+
+
+
+// the exported function to R
+// metrics, distanceCutoffs, linkageCutoffs: one entry per run; options as for
+// runRichCluster() (threads, storage, precision, export_distances,
+// collapse_duplicates, knn, mutual_knn, prune) plus keep_counts
+// [[Rcpp::export]]
+Rcpp::List runRichClusterMetrics(std::vector<std::string> terms,
+                                 std::vector<std::string> geneIDs,
+                                 std::vector<std::string> metrics,
+                                 std::vector<double> distanceCutoffs,
+                                 std::string linkageMethod,
+                                 std::vector<double> linkageCutoffs,
+                                 Rcpp::List options = Rcpp::List::create()) {
+  try {
+    if (distanceCutoffs.size() != metrics.size() || linkageCutoffs.size() != metrics.size())
+      throw std::invalid_argument("every metric needs one distance and one linkage cutoff");
+    DistanceStorageSpec storage = richCluster::storageSpec(options);
+    richCluster::RunSettings settings = richCluster::runSettings(options);
+    if (settings.knn > 0)
+      storage.backend = "ondemand";
+    if (!settings.shardFiles.empty())
+      throw std::invalid_argument("shard_files cannot be used with several metrics");
+    bool exportDistances = !options.containsElementNamed("export_distances")
+      || Rcpp::as<bool>(options["export_distances"]);
+    bool collapseDuplicates = options.containsElementNamed("collapse_duplicates")
+      && Rcpp::as<bool>(options["collapse_duplicates"]);
+    bool keepCounts = options.containsElementNamed("keep_counts")
+      && Rcpp::as<bool>(options["keep_counts"]);
+
+    std::vector<ClusterMetrics::Metric> runs;
+    for (size_t k=0; k<metrics.size(); ++k)
+      runs.push_back({metrics[k], distanceCutoffs[k], linkageCutoffs[k]});
+    ClusterMetrics cm(std::move(terms), geneIDs, collapseDuplicates);
+    cm.run(runs, linkageMethod, storage, settings, ResourcePlanner::settings(options),
+           exportDistances);
+    return cm.export_r(keepCounts);
+  } catch (Rcpp::internal::InterruptedException&) {
+    throw; // R handles the interrupt
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,60 @@
+//
+//  ClusterMetrics.h
+//  richCluster
+//
+
+#ifndef ClusterMetrics_h
+#define ClusterMetrics_h
+
+#include <Rcpp.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GeneSetList.h"
+#include "IntersectionCounts.h"
+#include "RichCluster.h"
+#include "ResourcePlanner.h"
+
+// One term list clustered under several distance metrics. The genes are
+// parsed, duplicate sets collapsed and |A n B| of every overlapping pair
+// counted once (see IntersectionCounts); every metric then scores its pairs
+// from those counts in O(1) each, so K metrics cost one counting pass
+// instead of K. Runs are sequential, each one using every thread.
+class ClusterMetrics {
+public:
+  struct Metric {
+    std::string distanceMetric;
+    double distanceCutoff;
+    double linkageCutoff;
+  };
+
+  ClusterMetrics(std::vector<std::string> terms, const std::vector<std::string>& geneIDs,
+                 bool collapseDuplicates = false);
+
+  // storage "auto" is resolved per metric by a ResourcePlanner with the given
+  // settings; settings.threads also count the intersections. exportDistances =
+  // false frees every run's scores as soon as it is clustered
+  void run(const std::vector<Metric>& metrics, const std::string& linkageMethod,
+           const DistanceStorageSpec& storage, const richCluster::RunSettings& settings,
+           const ResourcePlanner::Settings& planning, bool exportDistances = true);
+
+  // results: one runRichCluster()-like list per metric; stats: one row per
+  // metric; counts (see IntersectionCounts::export_r) if keepCounts
+  Rcpp::List export_r(bool keepCounts = false) const;
+
+private:
+  std::vector<std::string> terms;
+  GeneSetList geneSets;
+  std::vector<int> rowOf;
+  std::shared_ptr<const IntersectionCounts> counts;
+  double countSeconds = 0.0;
+
+  std::vector<Metric> metrics;
+  std::vector<std::unique_ptr<richCluster>> results;
+  std::vector<size_t> edges;
+  std::vector<double> seconds;
+  bool exportDistances = true;
+};
+
+#endif /* ClusterMetrics_h */
@@ -0,0 +1,160 @@
+//
+//  ClusterSession.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <stdexcept>
+#include "RichCluster.h"
+
+// a session keeps a richCluster (distances, adjacency, seeds, clusters) alive
+// behind an external pointer so later calls can reuse its state
+static Rcpp::XPtr<richCluster> sessionPtr(SEXP session) {
+  Rcpp::XPtr<richCluster> ptr(session);
+  if (ptr.get() == nullptr)
+    Rcpp::stop("cluster session is no longer valid (was it saved and reloaded?)");
+  return ptr;
+}
+
+// [[Rcpp::export]]
+SEXP createClusterSession(Rcpp::CharacterVector terms,
+                          Rcpp::CharacterVector geneIDs,
+                          std::string distanceMetric, double distanceCutoff,
+                          std::string linkageMethod, double linkageCutoff,
+                          Rcpp::List options = Rcpp::List::create()) {
+  try {
+    richCluster* RC = richCluster::create(terms, geneIDs,
+                                          distanceMetric, distanceCutoff,
+                                          linkageMethod, linkageCutoff,
+                                          options).release();
+    Rcpp::XPtr<richCluster> ptr(RC, true); // owns RC from here on
+    RC->run(options);
+    return ptr;
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::List sessionAddTerms(SEXP session, Rcpp::CharacterVector terms,
+                           Rcpp::CharacterVector geneIDs) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->addTerms(Rcpp::as<std::vector<std::string>>(terms),
+                        Rcpp::as<std::vector<std::string>>(geneIDs));
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::List sessionResult(SEXP session, bool exportDistances = true) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->export_result(exportDistances);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// frees the session's scores and adjacency once its result is exported; only
+// export_result(false) is valid afterwards
+// [[Rcpp::export]]
+void sessionRelease(SEXP session) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    RC->releaseDistances();
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// clusters of a subset of the session's terms (0-based input indices) over
+// its stored scores; TermIndices are positions in indices
+// [[Rcpp::export]]
+Rcpp::List sessionClusterSubset(SEXP session, Rcpp::IntegerVector indices,
+                                bool exportDistances = true) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->export_subset(Rcpp::as<std::vector<int>>(indices), exportDistances);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// FALSE once the session was serialized and loaded again (the pointer is then NULL)
+// [[Rcpp::export]]
+bool sessionValid(SEXP session) {
+  return TYPEOF(session) == EXTPTRSXP && R_ExternalPtrAddr(session) != nullptr;
+}
+
+// [[Rcpp::export]]
+Rcpp::NumericMatrix sessionSubmatrix(SEXP session, Rcpp::CharacterVector terms) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->export_submatrix(Rcpp::as<std::vector<std::string>>(terms));
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::DataFrame sessionTopNeighbours(SEXP session, std::string term, int k = 10) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->export_neighbours(term, k);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// compact edge list for igraph/networkD3; terms = NULL means all terms
+// [[Rcpp::export]]
+Rcpp::List sessionEdgeList(SEXP session, Rcpp::Nullable<Rcpp::CharacterVector> terms,
+                           double minScore, int topK = 0) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    std::vector<std::string> names;
+    if (terms.isNotNull())
+      names = Rcpp::as<std::vector<std::string>>(terms.get());
+    return RC->export_edges(names, minScore, topK);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// [[Rcpp::export]]
+Rcpp::List sessionDendrogram(SEXP session, std::string linkageMethod, bool seeds = false) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    return RC->export_dendrogram(linkageMethod, seeds);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// per-cluster summary (see richCluster::export_summary): clusters are 0-based
+// positions in terms, values a numeric matrix with one row per term and one
+// column per valueNames entry
+// [[Rcpp::export]]
+Rcpp::DataFrame sessionClusterSummary(SEXP session, Rcpp::CharacterVector terms,
+                                      Rcpp::List clusters, Rcpp::NumericMatrix values,
+                                      std::vector<std::string> valueNames, int threads = 1) {
+  Rcpp::XPtr<richCluster> RC = sessionPtr(session);
+  try {
+    if (values.nrow() != int(terms.size()) || values.ncol() != int(valueNames.size()))
+      throw std::invalid_argument("values must have one row per term and one column per value name");
+    std::vector<std::vector<int>> members;
+    for (int c=0; c<clusters.size(); ++c)
+      members.push_back(Rcpp::as<std::vector<int>>(clusters[c]));
+    std::vector<std::vector<double>> columns(values.ncol());
+    for (int v=0; v<values.ncol(); ++v)
+      columns[v].assign(values.begin() + size_t(v) * values.nrow(),
+                        values.begin() + size_t(v + 1) * values.nrow());
+    return RC->export_summary(Rcpp::as<std::vector<std::string>>(terms), members,
+                              valueNames, columns, threads);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
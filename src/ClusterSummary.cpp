@@ -0,0 +1,219 @@
+//
+//  ClusterSummary.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "ClusterSummary.h"
+#include "Parallel.h"
+
+namespace {
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+}
+
+ClusterSummary::ClusterSummary(int n, std::vector<std::vector<int>> clusters,
+                               const std::function<double(int, int)>& score,
+                               const std::function<void(int, const std::function<void(int)>&)>& linked,
+                               int threads):
+  clusters(std::move(clusters)) {
+  const int nClusters = int(this->clusters.size());
+  // term -> clusters holding it
+  std::vector<size_t> offsets(size_t(n) + 1, 0);
+  for (const auto& members : this->clusters) {
+    for (int a : members) {
+      if (a < 0 || a >= n)
+        throw std::out_of_range("cluster member " + std::to_string(a) + " is not a term");
+      ++offsets[a + 1];
+    }
+  }
+  for (int a=0; a<n; ++a) offsets[a + 1] += offsets[a];
+  std::vector<int> clustersOf(offsets[n]);
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (int c=0; c<nClusters; ++c)
+      for (int a : this->clusters[c]) clustersOf[fill[a]++] = c;
+  }
+
+  rows.resize(nClusters);
+  const int nWorkers = std::max(1, std::min(resolveThreads(threads), nClusters));
+  std::vector<std::vector<char>> marked(nWorkers);
+  parallelFor(nClusters, nWorkers, [&](int c, int worker) {
+    const std::vector<int>& members = this->clusters[c];
+    const int k = int(members.size());
+    Row& row = rows[c];
+    row.medoid = k > 0 ? members[0] : -1;
+    row.medoidScore = row.meanScore = row.minScore = row.nearestScore = NaN;
+
+    // every pair once; the medoid has the highest mean to the other members
+    if (k > 1) {
+      std::vector<double> sums(k, 0.0);
+      double total = 0.0, lowest = std::numeric_limits<double>::infinity();
+      for (int i=0; i<k; ++i) {
+        for (int j=i+1; j<k; ++j) {
+          const double s = score(members[i], members[j]);
+          sums[i] += s;
+          sums[j] += s;
+          total += s;
+          lowest = std::min(lowest, s);
+        }
+      }
+      const int best = int(std::max_element(sums.begin(), sums.end()) - sums.begin());
+      row.medoid = members[best];
+      row.medoidScore = sums[best] / (k - 1);
+      row.meanScore = total / (double(k) * (k - 1) / 2);
+      row.minScore = lowest;
+    }
+
+    // clusters sharing a term or an edge with this one
+    std::vector<char>& mark = marked[worker];
+    if (mark.empty()) mark.assign(nClusters, 0);
+    std::vector<int> candidates;
+    auto visit = [&](int b) {
+      for (size_t p=offsets[b]; p<offsets[b + 1]; ++p) {
+        const int d = clustersOf[p];
+        if (d != c && !mark[d]) {
+          mark[d] = 1;
+          candidates.push_back(d);
+        }
+      }
+    };
+    for (int a : members) {
+      visit(a);
+      linked(a, visit);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (int d : candidates) {
+      mark[d] = 0;
+      double sum = 0.0;
+      size_t pairs = 0;
+      for (int a : members) {
+        for (int b : this->clusters[d]) {
+          if (a != b) {
+            sum += score(a, b);
+            ++pairs;
+          }
+        }
+      }
+      if (pairs > 0 && (row.nearest < 0 || sum / pairs > row.nearestScore)) {
+        row.nearest = d;
+        row.nearestScore = sum / pairs;
+      }
+    }
+  });
+}
+
+void ClusterSummary::aggregate(const std::vector<std::string>& valueNames,
+                               const std::vector<std::vector<double>>& values, int threads) {
+  if (values.size() != valueNames.size())
+    throw std::invalid_argument("every value column needs a name");
+  this->valueNames = valueNames;
+  const int nClusters = int(clusters.size());
+  means.assign(values.size(), std::vector<double>(nClusters, NaN));
+  mins.assign(values.size(), std::vector<double>(nClusters, NaN));
+  parallelFor(nClusters, threads, [&](int c, int) {
+    for (size_t v=0; v<values.size(); ++v) {
+      double sum = 0.0, lowest = std::numeric_limits<double>::infinity();
+      int counted = 0;
+      for (int a : clusters[c]) {
+        const double x = values[v][a];
+        if (std::isnan(x)) continue;
+        sum += x;
+        lowest = std::min(lowest, x);
+        ++counted;
+      }
+      if (counted > 0) {
+        means[v][c] = sum / counted;
+        mins[v][c] = lowest;
+      }
+    }
+  });
+}
+
+Rcpp::DataFrame ClusterSummary::export_r(const std::vector<std::string>& terms) const {
+  const int n = int(rows.size());
+  Rcpp::IntegerVector clusterColumn(n), sizeColumn(n), nearestColumn(n);
+  Rcpp::CharacterVector medoidColumn(n);
+  Rcpp::NumericVector medoidScoreColumn(n), meanColumn(n), minColumn(n), nearestScoreColumn(n);
+  auto na = [](double x) { return std::isnan(x) ? NA_REAL : x; };
+  for (int c=0; c<n; ++c) {
+    const Row& row = rows[c];
+    clusterColumn[c] = c + 1;
+    sizeColumn[c] = int(clusters[c].size());
+    medoidColumn[c] = row.medoid < 0 ? NA_STRING : Rcpp::String(terms[row.medoid]);
+    medoidScoreColumn[c] = na(row.medoidScore);
+    meanColumn[c] = na(row.meanScore);
+    minColumn[c] = na(row.minScore);
+    nearestColumn[c] = row.nearest < 0 ? NA_INTEGER : row.nearest + 1;
+    nearestScoreColumn[c] = na(row.nearestScore);
+  }
+
+  const int fixed = 8, nColumns = fixed + 3 * int(valueNames.size());
+  Rcpp::List columns(nColumns);
+  Rcpp::CharacterVector names(nColumns);
+  columns[0] = clusterColumn;      names[0] = "Cluster";
+  columns[1] = sizeColumn;         names[1] = "Size";
+  columns[2] = medoidColumn;       names[2] = "Medoid";
+  columns[3] = medoidScoreColumn;  names[3] = "MedoidScore";
+  columns[4] = meanColumn;         names[4] = "MeanScore";
+  columns[5] = minColumn;          names[5] = "MinScore";
+  columns[6] = nearestColumn;      names[6] = "NearestCluster";
+  columns[7] = nearestScoreColumn; names[7] = "NearestScore";
+  for (size_t v=0; v<valueNames.size(); ++v) {
+    Rcpp::NumericVector meanValues(n), minValues(n), logValues(n);
+    for (int c=0; c<n; ++c) {
+      meanValues[c] = na(means[v][c]);
+      minValues[c] = na(mins[v][c]);
+      // as cluster_bar(): an infinite -log10 (a mean of 0) shows as 0
+      const double log = -std::log10(means[v][c]);
+      logValues[c] = std::isnan(log) ? NA_REAL : std::isinf(log) ? 0.0 : log;
+    }
+    const int at = fixed + 3 * int(v);
+    columns[at] = meanValues;     names[at] = "Mean_" + valueNames[v];
+    columns[at + 1] = minValues;  names[at + 1] = "Min_" + valueNames[v];
+    columns[at + 2] = logValues;  names[at + 2] = "NegLog10_" + valueNames[v];
+  }
+  columns.attr("names") = names;
+  return Rcpp::DataFrame(columns);
+}
+
+
+
+// the exported function to R
+// [[Rcpp::export]]
+Rcpp::DataFrame denseClusterSummary(Rcpp::NumericMatrix scores, Rcpp::CharacterVector terms,
+                                    Rcpp::List clusters, Rcpp::NumericMatrix values,
+                                    std::vector<std::string> valueNames,
+                                    double edgeCutoff, int threads = 1) {
+  try {
+    const int n = int(terms.size());
+    if (scores.nrow() != n || scores.ncol() != n)
+      throw std::invalid_argument("scores must have one row and column per term");
+    if (values.nrow() != n || values.ncol() != int(valueNames.size()))
+      throw std::invalid_argument("values must have one row per term and one column per value name");
+    std::vector<std::vector<int>> members;
+    for (int c=0; c<clusters.size(); ++c)
+      members.push_back(Rcpp::as<std::vector<int>>(clusters[c]));
+    std::vector<std::vector<double>> columns(values.ncol());
+    for (int v=0; v<values.ncol(); ++v)
+      columns[v].assign(values.begin() + size_t(v) * n, values.begin() + size_t(v + 1) * n);
+
+    // a dense distance_matrix: the edges are the pairs reaching the cutoff
+    const double* data = scores.begin();
+    ClusterSummary summary(n, members, [data, n](int a, int b) {
+      return data[size_t(b) * n + a];
+    }, [data, n, edgeCutoff](int a, const std::function<void(int)>& fn) {
+      for (int b=0; b<n; ++b)
+        if (b != a && data[size_t(b) * n + a] >= edgeCutoff) fn(b);
+    }, threads);
+    summary.aggregate(valueNames, columns, threads);
+    return summary.export_r(Rcpp::as<std::vector<std::string>>(terms));
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,53 @@
+//
+//  ClusterSummary.h
+//  richCluster
+//
+
+#ifndef ClusterSummary_h
+#define ClusterSummary_h
+
+#include <Rcpp.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Per-cluster report columns in one parallel pass over the clusters, reading
+// the stored scores of member pairs only: the medoid (the member with the
+// highest mean score to the others), the mean and minimum score within the
+// cluster, and the cluster closest on average. Candidates for the closest
+// cluster are those sharing a term or an edge with it, so a cluster costs
+// its own pairs plus the pairs with its neighbouring clusters; clusters with
+// neither have no nearest cluster. Value columns (eg. Padj per contrast) are
+// aggregated alongside. Workers use no R API.
+class ClusterSummary {
+public:
+  // clusters: member terms (0 .. n-1) of every cluster; score(a, b) of terms
+  // a != b; linked(a, fn) calls fn(b) for every term b sharing an edge with a
+  ClusterSummary(int n, std::vector<std::vector<int>> clusters,
+                 const std::function<double(int, int)>& score,
+                 const std::function<void(int, const std::function<void(int)>&)>& linked,
+                 int threads = 1);
+
+  // values: one column per entry of valueNames, one value per term (NaN for
+  // missing ones); every column gets Mean_, Min_ and NegLog10_ (of the mean)
+  // aggregates over the members
+  void aggregate(const std::vector<std::string>& valueNames,
+                 const std::vector<std::vector<double>>& values, int threads = 1);
+
+  Rcpp::DataFrame export_r(const std::vector<std::string>& terms) const;
+
+private:
+  struct Row {
+    int medoid = -1;
+    double medoidScore, meanScore, minScore; // NaN for a single term
+    int nearest = -1;                        // -1: no candidate
+    double nearestScore;
+  };
+
+  std::vector<std::vector<int>> clusters;
+  std::vector<Row> rows;
+  std::vector<std::string> valueNames;
+  std::vector<std::vector<double>> means, mins; // per value column, per cluster
+};
+
+#endif /* ClusterSummary_h */
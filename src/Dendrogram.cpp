@@ -0,0 +1,196 @@
+//
+//  Dendrogram.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "Dendrogram.h"
+
+Dendrogram::Dendrogram(int n, const std::function<double(int, int)>& dist,
+                       const std::string& linkageMethod): n(n) {
+  if (n < 2)
+    throw std::invalid_argument("a dendrogram needs at least two leaves");
+  if (linkageMethod == "single") {
+    method = "single";
+    label(minimumSpanningTree(dist));
+  } else if (linkageMethod == "complete" || linkageMethod == "average") {
+    method = linkageMethod;
+    label(nearestNeighbourChain(dist));
+  } else if (linkageMethod == "ward") {
+    method = "ward.D2";
+    label(nearestNeighbourChain(dist));
+  } else {
+    throw std::invalid_argument("unsupported linkage method: " + linkageMethod);
+  }
+}
+
+// Prim's algorithm: every leaf joins the tree by its closest tree leaf, and
+// the tree edges sorted by length are exactly the single linkage merges
+std::vector<Dendrogram::Step> Dendrogram::minimumSpanningTree(
+    const std::function<double(int, int)>& dist) const {
+  std::vector<char> inTree(n, 0);
+  std::vector<double> closest(n, std::numeric_limits<double>::infinity());
+  std::vector<int> closestTo(n, 0);
+  std::vector<Step> steps;
+  steps.reserve(n - 1);
+  int x = 0;
+  for (int k=0; k<n-1; ++k) {
+    inTree[x] = 1;
+    int y = -1;
+    double best = std::numeric_limits<double>::infinity();
+    for (int i=0; i<n; ++i) {
+      if (inTree[i]) continue;
+      double d = dist(x, i);
+      if (d < closest[i]) {
+        closest[i] = d;
+        closestTo[i] = x;
+      }
+      if (y < 0 || closest[i] < best) {
+        best = closest[i];
+        y = i;
+      }
+    }
+    steps.push_back({closestTo[y], y, best});
+    x = y;
+  }
+  return steps;
+}
+
+// Follows nearest neighbours until two clusters are each other's nearest
+// (reciprocal), merges them into the slot of the larger index and updates
+// its row with Lance-Williams. Valid for the reducible linkages (complete,
+// average, ward); ward works on squared dissimilarities like "ward.D2".
+std::vector<Dendrogram::Step> Dendrogram::nearestNeighbourChain(
+    const std::function<double(int, int)>& dist) const {
+  const bool ward = method == "ward.D2";
+  auto index = [this](int i, int j) { // condensed, i < j
+    return size_t(i) * (2 * size_t(n) - i - 1) / 2 + size_t(j - i - 1);
+  };
+  std::vector<double> D(size_t(n) * (n - 1) / 2);
+  for (int i=0; i<n; ++i) {
+    for (int j=i+1; j<n; ++j) {
+      double d = dist(i, j);
+      D[index(i, j)] = ward ? d * d : d;
+    }
+  }
+  auto at = [&](int i, int j) -> double& { return i < j ? D[index(i, j)] : D[index(j, i)]; };
+
+  std::vector<int> size(n, 1);
+  std::vector<int> active(n); // slots still holding a cluster, ascending
+  for (int i=0; i<n; ++i) active[i] = i;
+  std::vector<int> chain;
+  std::vector<Step> steps;
+  steps.reserve(n - 1);
+
+  for (int k=0; k<n-1; ++k) {
+    if (chain.empty())
+      chain.push_back(active[0]);
+
+    int x, y;
+    double current;
+    while (true) {
+      x = chain.back();
+      // the previous chain element wins ties, so the chain cannot cycle
+      y = chain.size() > 1 ? chain[chain.size() - 2] : -1;
+      current = y >= 0 ? at(x, y) : std::numeric_limits<double>::infinity();
+      for (int i : active) {
+        if (i == x) continue;
+        if (y < 0 || at(x, i) < current) {
+          current = at(x, i);
+          y = i;
+        }
+      }
+      if (chain.size() > 1 && y == chain[chain.size() - 2])
+        break;
+      chain.push_back(y);
+    }
+    chain.pop_back();
+    chain.pop_back();
+    if (x > y) std::swap(x, y);
+    steps.push_back({x, y, ward ? std::sqrt(current) : current});
+
+    // the merged cluster lives on in slot y
+    const double nx = size[x], ny = size[y];
+    for (int i : active) {
+      if (i == x || i == y) continue;
+      double dix = at(i, x), diy = at(i, y);
+      const double ni = size[i];
+      if (method == "complete")
+        at(i, y) = std::max(dix, diy);
+      else if (method == "average")
+        at(i, y) = (nx * dix + ny * diy) / (nx + ny);
+      else
+        at(i, y) = ((ni + nx) * dix + (ni + ny) * diy - ni * current) / (ni + nx + ny);
+    }
+    size[y] += size[x];
+    active.erase(std::lower_bound(active.begin(), active.end(), x));
+  }
+  return steps;
+}
+
+void Dendrogram::label(std::vector<Step> steps) {
+  std::stable_sort(steps.begin(), steps.end(),
+                   [](const Step& s, const Step& t) { return s.height < t.height; });
+
+  // cluster of every leaf so far: -leaf (1-based) or the 1-based merge step
+  std::vector<int> parent(n);
+  for (int i=0; i<n; ++i) parent[i] = i;
+  auto find = [&parent](int x) {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  };
+  std::vector<int> clusterOf(n);
+  for (int i=0; i<n; ++i) clusterOf[i] = -(i + 1);
+
+  merge.clear();
+  height.clear();
+  for (size_t k=0; k<steps.size(); ++k) {
+    int ra = find(steps[k].a), rb = find(steps[k].b);
+    int ca = clusterOf[ra], cb = clusterOf[rb];
+    // hclust lists leaves before clusters, and smaller numbers first
+    if ((ca > 0 && cb < 0) || (ca < 0 && cb < 0 && ca < cb) || (ca > 0 && cb > 0 && ca > cb))
+      std::swap(ca, cb);
+    merge.emplace_back(ca, cb);
+    height.push_back(steps[k].height);
+    parent[std::max(ra, rb)] = std::min(ra, rb);
+    clusterOf[std::min(ra, rb)] = int(k) + 1;
+  }
+
+  // leaves left to right: expand the last merge, left subtree first
+  order.clear();
+  std::vector<int> stack{int(merge.size())};
+  while (!stack.empty()) {
+    int c = stack.back();
+    stack.pop_back();
+    if (c < 0) {
+      order.push_back(-c);
+      continue;
+    }
+    stack.push_back(merge[c - 1].second);
+    stack.push_back(merge[c - 1].first);
+  }
+}
+
+Rcpp::List Dendrogram::export_r(const std::vector<std::string>& labels) const {
+  Rcpp::IntegerMatrix mergeMatrix(n - 1, 2);
+  for (int k=0; k<n-1; ++k) {
+    mergeMatrix(k, 0) = merge[k].first;
+    mergeMatrix(k, 1) = merge[k].second;
+  }
+  return Rcpp::List::create(
+    Rcpp::_["merge"]  = mergeMatrix,
+    Rcpp::_["height"] = Rcpp::NumericVector(height.begin(), height.end()),
+    Rcpp::_["order"]  = Rcpp::IntegerVector(order.begin(), order.end()),
+    Rcpp::_["labels"] = Rcpp::CharacterVector(labels.begin(), labels.end()),
+    Rcpp::_["method"] = method
+  );
+}
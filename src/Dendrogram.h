@@ -0,0 +1,49 @@
+//
+//  Dendrogram.h
+//  richCluster
+//
+
+#ifndef Dendrogram_h
+#define Dendrogram_h
+
+#include <Rcpp.h>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Complete agglomerative clustering of n leaves in R's hclust format, so a
+// tree can be cut at any height afterwards instead of rerunning a flat
+// clustering per cutoff. Single linkage is the minimum spanning tree (Prim,
+// O(n^2) time, no matrix); complete, average and ward ("ward.D2") run the
+// nearest-neighbour chain over a condensed copy of the dissimilarities with
+// Lance-Williams updates (O(n^2) time and memory).
+class Dendrogram {
+public:
+  // dist(a, b) is the dissimilarity of leaves a != b
+  Dendrogram(int n, const std::function<double(int, int)>& dist, const std::string& method);
+
+  // merge (hclust convention: -leaf for leaves, 1-based step for clusters),
+  // height, order and labels as hclust; method is the hclust name
+  Rcpp::List export_r(const std::vector<std::string>& labels) const;
+
+private:
+  // one merge of the clusters holding leaves a and b
+  struct Step {
+    int a, b;
+    double height;
+  };
+
+  int n;
+  std::string method;
+  std::vector<std::pair<int, int>> merge;
+  std::vector<double> height;
+  std::vector<int> order;
+
+  std::vector<Step> minimumSpanningTree(const std::function<double(int, int)>& dist) const;
+  std::vector<Step> nearestNeighbourChain(const std::function<double(int, int)>& dist) const;
+  // sorts the steps by height and numbers the clusters as hclust does
+  void label(std::vector<Step> steps);
+};
+
+#endif /* Dendrogram_h */
@@ -8,21 +8,127 @@
 #include <stdio.h>
 #include "DistanceMatrix.h"
 #include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 
-int DistanceMatrix::getDistanceIndex(int t1, int t2) const {
-  int row_index = t1;
-  int col_index = t2;
-  return (row_index * n_terms) + col_index;
+DistanceMatrix::DistanceMatrix(int n_terms, std::vector<std::string>& terms,
+                               const DistanceStorageSpec& spec,
+                               std::pair<double, double> scoreRange):
+  spec(spec), precisionName(spec.precision), scoreRange(scoreRange), n_terms(n_terms), terms(terms) {
+  if (spec.precision == "double") {
+    precision = Precision::Double;
+  } else if (spec.precision == "float") {
+    precision = Precision::Float;
+    valueBytes = sizeof(float);
+  } else if (spec.precision == "int16" || spec.precision == "uint8") {
+    if (!std::isfinite(scoreRange.first) || !std::isfinite(scoreRange.second))
+      throw std::invalid_argument(spec.precision + " precision needs a bounded distance metric");
+    if (spec.precision == "int16") {
+      precision = Precision::Int16;
+      valueBytes = sizeof(int16_t);
+      codeMin = -32767;
+      codeMax = 32767;
+      codeOffset = (scoreRange.first + scoreRange.second) / 2;
+    } else {
+      precision = Precision::UInt8;
+      valueBytes = sizeof(uint8_t);
+      codeMin = 0;
+      codeMax = 254;
+      codeOffset = scoreRange.first;
+    }
+    codeStep = (scoreRange.second - scoreRange.first) / (codeMax - codeMin);
+  } else {
+    throw std::invalid_argument("unsupported distance precision: " + spec.precision);
+  }
+  
+  if (spec.backend == "mmap") {
+    if (spec.path.empty())
+      throw std::invalid_argument("mmap distance storage needs a file path");
+    tileSize = TILE_SIZE;
+  } else if (spec.backend == "sparse") {
+    sparse = true;
+    sparseScores = AdjacencyList(n_terms);
+    return;
+  } else if (spec.backend == "ondemand") {
+    onDemand = true;
+    return;
+  } else if (spec.backend != "memory") {
+    throw std::invalid_argument("unsupported distance storage: " + spec.backend);
+  }
+  allocate(n_terms);
+}
+
+void DistanceMatrix::allocate(int newCapacity) {
+  capacity = newCapacity;
+  if (tileSize > 0) {
+    tilesPerRow = (size_t(capacity) + TILE_SIZE - 1) / TILE_SIZE;
+    // the old mapping's file is already unlinked, so the path can be reused
+    storage.reset(new MappedStorage(tilesPerRow * tilesPerRow * TILE_SIZE * TILE_SIZE * valueBytes,
+                                    spec.path));
+  } else {
+    storage.reset(new MemoryStorage(size_t(capacity) * size_t(capacity) * valueBytes));
+  }
+  values = storage->data();
+}
+
+double DistanceMatrix::setSparseDistance(double distance, int t1, int t2) {
+  if (t1 != t2)
+    throw std::logic_error("sparse distances are filled in bulk (fillSparse)");
+  return diagonal = distance;
+}
+
+void DistanceMatrix::appendTerms(const std::vector<std::string>& newTerms) {
+  if (sparse)
+    throw std::invalid_argument("sparse distance storage cannot add terms, use 'memory', 'mmap' or 'ondemand'");
+  int oldN = n_terms;
+  terms.insert(terms.end(), newTerms.begin(), newTerms.end());
+  n_terms = int(terms.size());
+  if (onDemand || n_terms <= capacity)
+    return;
+  
+  // grow geometrically and copy the existing block over
+  std::unique_ptr<DistanceStorage> oldStorage = std::move(storage);
+  const unsigned char* oldValues = static_cast<const unsigned char*>(oldStorage->data());
+  int oldCapacity = capacity;
+  size_t oldTilesPerRow = tilesPerRow;
+  allocate(std::max(n_terms, oldCapacity + oldCapacity / 2));
+  
+  unsigned char* newValues = static_cast<unsigned char*>(values);
+  for (int i = 0; i < oldN; ++i) {
+    for (int j = 0; j < oldN; ++j) {
+      size_t from;
+      if (tileSize == 0) {
+        from = size_t(i) * size_t(oldCapacity) + size_t(j);
+      } else {
+        size_t tile = size_t(i >> TILE_SHIFT) * oldTilesPerRow + size_t(j >> TILE_SHIFT);
+        from = (tile << (2 * TILE_SHIFT)) + (size_t(i & (TILE_SIZE - 1)) << TILE_SHIFT)
+          + size_t(j & (TILE_SIZE - 1));
+      }
+      std::memcpy(newValues + getDistanceIndex(i, j) * valueBytes, oldValues + from * valueBytes, valueBytes);
+    }
+  }
 }
 
-double DistanceMatrix::getDistance(int t1, int t2) const {
-  int i = DistanceMatrix::getDistanceIndex(t1, t2);
-  return distances[i];
-} 
+double DistanceMatrix::quantize(double distance) const {
+  switch (precision) {
+    case Precision::Double: return distance;
+    case Precision::Float:  return static_cast<float>(distance);
+    default:                return decode(encode(distance));
+  }
+}
 
-void DistanceMatrix::setDistance(double distance, int t1, int t2) {
-  int i = DistanceMatrix::getDistanceIndex(t1, t2);
-  distances[i] = distance;
+double DistanceMatrix::maxQuantizationError() const {
+  double maxAbs = std::max(std::fabs(scoreRange.first), std::fabs(scoreRange.second));
+  switch (precision) {
+    case Precision::Double: return 0.0;
+    // half an ulp, relative to the largest magnitude in range
+    case Precision::Float:
+      return std::isfinite(maxAbs) ? maxAbs * std::ldexp(1.0, -24) : NA_REAL;
+    default:                return codeStep / 2;
+  }
 }
 
 // export utility to R
@@ -38,3 +144,17 @@ Rcpp::NumericMatrix DistanceMatrix::export_r() const {
   dm.attr("dimnames") = dimnames;
   return dm;
 }
+
+Rcpp::NumericMatrix DistanceMatrix::export_r(const std::vector<int>& indices) const {
+  int n = int(indices.size());
+  Rcpp::NumericMatrix dm(n, n);
+  Rcpp::CharacterVector names(n);
+  for (int i = 0; i < n; ++i) {
+    names[i] = terms[indices[i]];
+    for (int j = 0; j < n; ++j) {
+      dm(i, j) = getDistance(indices[i], indices[j]);
+    }
+  }
+  dm.attr("dimnames") = Rcpp::List::create(names, names);
+  return dm;
+}
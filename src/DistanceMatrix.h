@@ -9,28 +9,180 @@
 #define DistanceMatrix_h
 
 #include <Rcpp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "DistanceStorage.h"
+#include "AdjacencyList.h"
 
 class DistanceMatrix {
 public:
-  DistanceMatrix(int n_terms, std::vector<std::string>& terms):
-  n_terms(n_terms), terms(terms) {
-    distances.resize(n_terms * n_terms);
+  // scoreRange is the [min, max] a metric can produce; int16/uint8 storage
+  // spreads its codes evenly over it, so it must be finite for those precisions
+  DistanceMatrix(int n_terms, std::vector<std::string>& terms,
+                 const DistanceStorageSpec& spec = DistanceStorageSpec(),
+                 std::pair<double, double> scoreRange = {-1.0, 1.0});
+  
+  double getDistance(int t1, int t2) const {
+    if (sparse)
+      return getSparseDistance(t1, t2);
+    if (onDemand)
+      return t1 == t2 ? diagonal : scorer(t1, t2);
+    size_t i = getDistanceIndex(t1, t2);
+    switch (precision) {
+      case Precision::Double: return static_cast<const double*>(values)[i];
+      case Precision::Float:  return static_cast<const float*>(values)[i];
+      case Precision::Int16:
+        return t1 == t2 ? diagonal : decode(static_cast<const int16_t*>(values)[i]);
+      case Precision::UInt8:
+        return t1 == t2 ? diagonal : decode(static_cast<const uint8_t*>(values)[i]);
+    }
+    return 0.0;
+  };
+  // returns the value as it will be read back (after rounding to the storage precision)
+  double setDistance(double distance, int t1, int t2) {
+    if (sparse)
+      return setSparseDistance(distance, t1, t2);
+    if (onDemand) // nothing to keep, reads recompute the (rounded) score
+      return t1 == t2 ? diagonal = distance : quantize(distance);
+    size_t i = getDistanceIndex(t1, t2);
+    switch (precision) {
+      case Precision::Double:
+        static_cast<double*>(values)[i] = distance;
+        return distance;
+      case Precision::Float:
+        static_cast<float*>(values)[i] = static_cast<float>(distance);
+        return static_cast<float>(distance);
+      case Precision::Int16:
+        if (t1 == t2) return diagonal = distance;
+        static_cast<int16_t*>(values)[i] = static_cast<int16_t>(encode(distance));
+        return decode(encode(distance));
+      case Precision::UInt8:
+        if (t1 == t2) return diagonal = distance;
+        static_cast<uint8_t*>(values)[i] = static_cast<uint8_t>(encode(distance));
+        return decode(encode(distance));
+    }
+    return distance;
   };
   
-  double getDistance(int t1, int t2) const;
-  void setDistance(double distance, int t1, int t2);
+  // the value a score is stored as; cutoffs go through the same rounding so a
+  // pair passes iff its code >= the cutoff's code
+  double quantize(double distance) const;
+  // worst-case |stored - score| for scores inside scoreRange (NA if unbounded)
+  double maxQuantizationError() const;
+  const std::string& getPrecision() const { return precisionName; };
+  
+  // grows the matrix by the given terms; their rows/cols start out at 0 and
+  // existing scores are kept (storage is over-allocated so small appends are free)
+  void appendTerms(const std::vector<std::string>& newTerms);
+  
+  // rows/cols are filled block by block so tiles are written sequentially;
+  // row-major storage uses the same blocks as units of (parallel) work
+  int blockSize() const { return TILE_SIZE; };
+  void beginFill() { if (storage) storage->adviseSequential(); };
+  void endFill() { if (storage) storage->adviseNormal(); };
+  
+  // "sparse" storage keeps only the pairs sharing a gene (every other pair
+  // scores 0 under every metric) in CSR rows, so it is exact; the rows are
+  // built in bulk from the (quantized) scores of all pairs with an overlap
+  bool isSparse() const { return sparse; };
+  void fillSparse(std::vector<AdjacencyList::EdgeBuffer>& overlaps) {
+    sparseScores.build(n_terms, overlaps);
+  };
+  
+  // "ondemand" storage keeps no scores: every read calls the scorer (which
+  // must round like quantize()), so memory stays O(n) at the cost of
+  // rescoring the pair; reads may come from several threads at once
+  bool isOnDemand() const { return onDemand; };
+  bool isReleased() const { return released; };
+  void setScorer(std::function<double(int, int)> fn) { scorer = std::move(fn); };
+  // sparse storage filled without the pairs a size bound ruled out (see
+  // SizeBound): reading one of those that is not stored calls the scorer
+  void setUnscored(std::function<bool(int, int)> fn) { unscored = std::move(fn); };
+  
+  // frees the stored scores once only the clusters are needed; nothing may be
+  // read from the matrix afterwards
+  void release() {
+    released = true;
+    storage.reset();
+    values = nullptr;
+    capacity = 0;
+    sparseScores = AdjacencyList();
+  };
   
   Rcpp::NumericMatrix export_r() const;
+  // rows/cols of the given terms only, in the given order
+  Rcpp::NumericMatrix export_r(const std::vector<int>& indices) const;
   
 private:
-  std::vector<double> distances; // matrix is internally stored flattened
+  enum class Precision { Double, Float, Int16, UInt8 };
+  
+  std::unique_ptr<DistanceStorage> storage;
+  void* values; // matrix is internally stored flattened
+  DistanceStorageSpec spec;
+  size_t valueBytes = sizeof(double);
+  int capacity = 0; // allocated rows/cols (>= n_terms)
+  void allocate(int newCapacity);
+  
+  // storage precision; fixed point codes map linearly to
+  //   score = codeOffset + code * codeStep, rounded half up
+  // int16 uses codes -32767..32767, uint8 uses 0..254, so an even number of
+  // steps spans scoreRange and its midpoint is exact
+  Precision precision = Precision::Double;
+  std::string precisionName;
+  std::pair<double, double> scoreRange;
+  double codeOffset = 0.0, codeStep = 1.0;
+  int codeMin = 0, codeMax = 0;
+  double diagonal = 0.0; // quantized storage keeps the (constant) diagonal aside
+  
+  int encode(double distance) const {
+    double code = std::floor((distance - codeOffset) / codeStep + 0.5);
+    if (code < codeMin) return codeMin;
+    if (code > codeMax) return codeMax;
+    return int(code);
+  };
+  double decode(int code) const { return codeOffset + code * codeStep; };
   
   // useful vars
   int n_terms;
   std::vector<std::string> terms;
   
+  // tiled layout (mmap): TILE_SIZE x TILE_SIZE row-major tiles, so the rows
+  // a seed touches together share pages; tileSize == 0 means plain row-major
+  static constexpr int TILE_SHIFT = 6;
+  static constexpr int TILE_SIZE = 1 << TILE_SHIFT; // 64 x 64 values per tile
+  int tileSize = 0;
+  size_t tilesPerRow = 0;
+  
+  bool sparse = false;
+  AdjacencyList sparseScores;
+  double getSparseDistance(int t1, int t2) const {
+    if (t1 == t2) return diagonal;
+    AdjacencyList::Span<int> row = sparseScores.getNeighbors(t1);
+    const int* it = std::lower_bound(row.begin(), row.end(), t2);
+    if (it != row.end() && *it == t2)
+      return sparseScores.getScores(t1)[it - row.begin()];
+    return unscored && unscored(t1, t2) ? scorer(t1, t2) : 0.0;
+  };
+  // only the diagonal can be set one value at a time
+  double setSparseDistance(double distance, int t1, int t2);
+  
+  bool onDemand = false;
+  bool released = false; // see release()
+  std::function<double(int, int)> scorer;
+  std::function<bool(int, int)> unscored;
+  
   // index into flattened list
-  int getDistanceIndex(int t1, int t2) const;
+  size_t getDistanceIndex(int t1, int t2) const {
+    if (tileSize == 0)
+      return size_t(t1) * size_t(capacity) + size_t(t2);
+    size_t tile = (size_t(t1 >> TILE_SHIFT) * tilesPerRow + size_t(t2 >> TILE_SHIFT));
+    return (tile << (2 * TILE_SHIFT)) + (size_t(t1 & (TILE_SIZE - 1)) << TILE_SHIFT)
+      + size_t(t2 & (TILE_SIZE - 1));
+  };
 };
 
 #endif /* DistanceMatrix_h */
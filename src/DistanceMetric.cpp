@@ -8,67 +8,137 @@
 
 #include <stdio.h>
 #include "DistanceMetric.h"
-#include <unordered_set>
 #include <string>
 #include <stdexcept>
-#include <algorithm>  // for std::set_intersection
-#include <iterator>   // for std::inserter
-
-double DistanceMetric::computeDistance(const std::unordered_set<std::string>& t1_genes,
-                                       const std::unordered_set<std::string>& t2_genes,
-                                       int totalGeneCount) {
-  if (metric=="kappa")
-    return getKappa(t1_genes, t2_genes, totalGeneCount);
-  else if (metric=="jaccard")
-    return getJaccard(t1_genes, t2_genes);
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+DistanceMetric::DistanceMetric(std::string distanceMetric, double distanceCutoff)
+  : name(distanceMetric), cutoff(distanceCutoff) {
+  if (name=="kappa")
+    metric = Metric::Kappa;
+  else if (name=="jaccard")
+    metric = Metric::Jaccard;
+  else if (name=="hypergeometric")
+    metric = Metric::Hypergeometric;
+  else if (name=="overlap")
+    metric = Metric::Overlap;
+  else if (name=="dice")
+    metric = Metric::Dice;
   else
-    throw std::invalid_argument("unsupported distance metric: " + metric);
+    throw std::invalid_argument("unsupported distance metric: " + name);
+}
+
+// log(k!) for k = 0..N, built once so each pair only needs table lookups
+void DistanceMetric::setTotalGeneCount(int totalGeneCount) {
+  this->totalGeneCount = totalGeneCount;
+  if (metric != Metric::Hypergeometric)
+    return;
+  logFactorial.assign(totalGeneCount + 1, 0.0);
+  for (int k = 2; k <= totalGeneCount; ++k)
+    logFactorial[k] = logFactorial[k - 1] + std::log(double(k));
+}
+
+std::pair<double, double> DistanceMetric::scoreRange(const std::string& distanceMetric) {
+  if (distanceMetric=="kappa")
+    return {-1.0, 1.0};
+  if (distanceMetric=="hypergeometric")
+    return {0.0, std::numeric_limits<double>::infinity()};
+  return {0.0, 1.0}; // jaccard, overlap, dice
+}
+
+double DistanceMetric::computeDistance(int common, int t1_size, int t2_size) const {
+  switch (metric) {
+    case Metric::Kappa:          return getKappa(common, t1_size, t2_size);
+    case Metric::Jaccard:        return getJaccard(common, t1_size, t2_size);
+    case Metric::Hypergeometric: return getHypergeometric(common, t1_size, t2_size);
+    case Metric::Overlap:        return getOverlap(common, t1_size, t2_size);
+    case Metric::Dice:           return getDice(common, t1_size, t2_size);
+  }
+  return 0.0;
 }
 
 
 // the various distance metric computations
 // kappa is the standard
-double DistanceMetric::getKappa(const std::unordered_set<std::string>& t1_genes,
-                                const std::unordered_set<std::string>& t2_genes,
-                                int totalGeneCount) {
-  
-  // Calculate the intersection of t1_genes and t2_genes
-  std::unordered_set<std::string> intersection;
-  std::set_intersection(t1_genes.begin(), t1_genes.end(), t2_genes.begin(), t2_genes.end(), std::inserter(intersection, intersection.begin()));
-  
-  double common = static_cast<double>(intersection.size()); // Number of common genes
-  
+double DistanceMetric::getKappa(int common_count, int t1_size, int t2_size) const {
+  double common = static_cast<double>(common_count); // Number of common genes
+
   if (common == 0) {
     return 0.0; // return 0 if no overlapping genes
-  } 
-  
-  double t1_only = t1_genes.size() - common; // Genes unique to t1_genes
-  double t2_only = t2_genes.size() - common; // Genes unique to t2_genes
-  
+  }
+
+  double t1_only = t1_size - common; // Genes unique to t1_genes
+  double t2_only = t2_size - common; // Genes unique to t2_genes
+
   double unique = totalGeneCount - common - t1_only - t2_only; // Count of all genes not found in either term
-  
+
   double relative_observed_agree = (common + unique) / totalGeneCount;
   double chance_yes = ((common + t1_only) / totalGeneCount) * ((common + t2_only) / totalGeneCount);
   double chance_no = ((unique + t1_only) / totalGeneCount) * ((unique + t2_only) / totalGeneCount);
   double chance_agree = chance_yes + chance_no;
-  
+
   if (chance_agree == 1)
     return 0.0; // prevent divide by zero
   else
     return (relative_observed_agree - chance_agree) / (1 - chance_agree); // return kappa!
 }
 
-double DistanceMetric::getJaccard(const std::unordered_set<std::string>& t1_genes,
-                                  const std::unordered_set<std::string>& t2_genes) {
-  std::unordered_set<std::string> intersection; 
-  double common = 0;
-  for (const auto& gene : t1_genes) {
-    if (t2_genes.count(gene)) {
-      ++common;
-    }
+// |A n B| / |A u B|
+double DistanceMetric::getJaccard(int common, int t1_size, int t2_size) const {
+  int total = t1_size + t2_size - common;
+  return total == 0 ? 0.0 : static_cast<double>(common) / total;
+}
+
+// -log10 P(X >= common) for X ~ Hypergeometric(N, |A|, |B|), ie. the
+// one-sided Fisher exact test for over-representation of the overlap
+double DistanceMetric::getHypergeometric(int common, int t1_size, int t2_size) const {
+  if (common == 0)
+    return 0.0; // P(X >= 0) = 1
+  // symmetric in the sets; a fixed order keeps the rounding symmetric too, so
+  // a pair scores the same whichever of its terms comes first
+  if (t1_size > t2_size)
+    std::swap(t1_size, t2_size);
+  int N = totalGeneCount;
+  int maxCommon = std::min(t1_size, t2_size);
+
+  // log P(X = common) straight from the table
+  double logP = logChoose(t1_size, common) + logChoose(N - t1_size, t2_size - common)
+    - logChoose(N, t2_size);
+
+  // sum the upper tail relative to P(X = common) using the term ratio
+  //   P(x+1) / P(x) = (|A|-x)(|B|-x) / ((x+1)(N-|A|-|B|+x+1))
+  // This is not O(1): past the mode the terms shrink geometrically, so an
+  // overlap well above the expected one stops after a few steps, but one at
+  // or below the mode walks up to it and then a few standard deviations
+  // beyond (O(mode - common + sqrt(mode)) steps, capped by min(|A|, |B|)),
+  // plus one log. Those pairs have P(X >= common) of about 1/2 or more, ie.
+  // score about 0.3 or less.
+  double tail = 1.0, term = 1.0;
+  for (int x = common; x < maxCommon; ++x) {
+    term *= static_cast<double>(t1_size - x) * (t2_size - x)
+      / (static_cast<double>(x + 1) * (N - t1_size - t2_size + x + 1));
+    tail += term;
+    if (term < tail * 1e-16 && term < 1.0)
+      break;
   }
-  // double common = static_cast<double>(intersection.size()); // number of common genes
-  double total = static_cast<double>(t1_genes.size()) + static_cast<double>(t2_genes.size());
-  
-  return common / total;
+  double score = -(logP + std::log(tail)) / std::log(10.0);
+  return score > 0.0 ? score : 0.0;
+}
+
+// |A n B| / min(|A|, |B|)
+double DistanceMetric::getOverlap(int common, int t1_size, int t2_size) const {
+  int smaller = std::min(t1_size, t2_size);
+  return smaller == 0 ? 0.0 : static_cast<double>(common) / smaller;
+}
+
+// 2|A n B| / (|A| + |B|)
+double DistanceMetric::getDice(int common, int t1_size, int t2_size) const {
+  int total = t1_size + t2_size;
+  return total == 0 ? 0.0 : 2.0 * common / total;
+}
+
+double DistanceMetric::logChoose(int n, int k) const {
+  return logFactorial[n] - logFactorial[k] - logFactorial[n - k];
 }
@@ -8,30 +8,47 @@
 #ifndef DistanceMetric_h
 #define DistanceMetric_h
 
-#include <unordered_set>
 #include <string>
+#include <utility>
+#include <vector>
 
 class DistanceMetric {
 public:
-  DistanceMetric(std::string distanceMetric, double distanceCutoff)
-    : metric(distanceMetric), cutoff(distanceCutoff) {};
-  
-  double computeDistance(
-      const std::unordered_set<std::string>& t1_genes,
-      const std::unordered_set<std::string>& t2_genes,
-      int totalGeneCount);
-  double getCutoff() { return cutoff; };
+  DistanceMetric(std::string distanceMetric, double distanceCutoff);
+
+  // every supported metric is a function of (|A n B|, |A|, |B|, N) only; all
+  // are O(1) except "hypergeometric", whose upper-tail sum takes a few steps
+  // for overlaps above the expected one and up to O(min(|A|, |B|)) below it
+  double computeDistance(int common, int t1_size, int t2_size) const;
+  double getCutoff() const { return cutoff; };
+  const std::string& getName() const { return name; };
+
+  // sizes the log-factorial table to the gene universe (N)
+  void setTotalGeneCount(int totalGeneCount);
+  // kappa and hypergeometric scores change with N, the others only see the two sets
+  bool dependsOnTotalGeneCount() const {
+    return metric == Metric::Kappa || metric == Metric::Hypergeometric;
+  };
   
+  // [min, max] score of a metric (max is infinite for "hypergeometric")
+  static std::pair<double, double> scoreRange(const std::string& distanceMetric);
+
 private:
-  std::string metric;
+  enum class Metric { Kappa, Jaccard, Hypergeometric, Overlap, Dice };
+
+  std::string name;
+  Metric metric;
   double cutoff;
-  
+  int totalGeneCount = 0;
+  std::vector<double> logFactorial; // logFactorial[k] = log(k!), k = 0..N
+
   // methods
-  double getKappa(const std::unordered_set<std::string>& t1_genes,
-                  const std::unordered_set<std::string>& t2_genes,
-                  int totalGeneCount);
-  double getJaccard(const std::unordered_set<std::string>& t1_genes,
-                    const std::unordered_set<std::string>& t2_genes);
+  double getKappa(int common, int t1_size, int t2_size) const;
+  double getJaccard(int common, int t1_size, int t2_size) const;
+  double getHypergeometric(int common, int t1_size, int t2_size) const;
+  double getOverlap(int common, int t1_size, int t2_size) const;
+  double getDice(int common, int t1_size, int t2_size) const;
+  double logChoose(int n, int k) const;
 };
 
 #endif /* DistanceMetric_h */
@@ -0,0 +1,206 @@
+//
+//  DistanceShard.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "DistanceShard.h"
+
+namespace {
+
+const char SHARD_MAGIC[8] = {'R', 'C', 'S', 'H', 'A', 'R', 'D', '1'};
+const char SHARD_END[8]   = {'R', 'C', 'S', 'H', 'D', 'E', 'N', 'D'};
+
+struct ShardHeader {
+  int32_t n_terms, shardIndex, nShards, rowStart, rowEnd;
+  uint64_t fingerprint;
+};
+
+// magic + 5 ints + fingerprint
+const std::streamoff HEADER_BYTES = 8 + 5 * sizeof(int32_t) + sizeof(uint64_t);
+const std::streamoff FOOTER_BYTES = 8 + sizeof(uint64_t);
+
+template <typename T>
+void writeValue(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::ifstream& in, T& value) {
+  return bool(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+bool readHeader(std::ifstream& in, ShardHeader& h) {
+  char magic[8];
+  if (!in.read(magic, 8) || !std::equal(magic, magic + 8, SHARD_MAGIC))
+    return false;
+  return readValue(in, h.n_terms) && readValue(in, h.shardIndex) && readValue(in, h.nShards)
+    && readValue(in, h.rowStart) && readValue(in, h.rowEnd) && readValue(in, h.fingerprint);
+}
+
+// number of upper-triangle pairs in rows [rowStart, rowEnd)
+uint64_t pairsInRows(int n_terms, int rowStart, int rowEnd) {
+  uint64_t pairs = 0;
+  for (int i = rowStart; i < rowEnd; ++i)
+    pairs += uint64_t(n_terms - 1 - i);
+  return pairs;
+}
+
+} // namespace
+
+std::pair<int, int> DistanceShard::rowRange(int n_terms, int shardIndex, int nShards) {
+  if (nShards < 1 || shardIndex < 0 || shardIndex >= nShards)
+    throw std::invalid_argument("shard index out of range");
+  const uint64_t totalPairs = pairsInRows(n_terms, 0, n_terms);
+
+  // first row whose preceding pair count reaches the shard's share
+  auto boundary = [&](int s) {
+    if (s >= nShards) return n_terms;
+    uint64_t target = totalPairs * uint64_t(s) / uint64_t(nShards);
+    uint64_t before = 0;
+    int i = 0;
+    while (i < n_terms && before < target) {
+      before += uint64_t(n_terms - 1 - i);
+      ++i;
+    }
+    return i;
+  };
+  return {boundary(shardIndex), boundary(shardIndex + 1)};
+}
+
+// 64-bit FNV-1a over the metric name and every geneID string
+uint64_t DistanceShard::fingerprint(const std::vector<std::string>& geneIDs,
+                                    const std::string& distanceMetric) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](const std::string& s) {
+    for (unsigned char c : s) {
+      hash ^= c;
+      hash *= 1099511628211ULL;
+    }
+    hash ^= 0xff; // separator
+    hash *= 1099511628211ULL;
+  };
+  mix(distanceMetric);
+  for (const std::string& genes : geneIDs)
+    mix(genes);
+  return hash;
+}
+
+void DistanceShard::write(const std::string& path, const GeneSetList& geneSets,
+                          const DistanceMetric& dm, int shardIndex, int nShards,
+                          uint64_t fingerprint) {
+  const int n_terms = int(geneSets.n_terms());
+  const std::pair<int, int> rows = rowRange(n_terms, shardIndex, nShards);
+  const std::string tmpPath = path + ".tmp";
+
+  std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+  if (!out)
+    throw std::runtime_error("cannot open shard file for writing: " + tmpPath);
+
+  out.write(SHARD_MAGIC, 8);
+  writeValue(out, int32_t(n_terms));
+  writeValue(out, int32_t(shardIndex));
+  writeValue(out, int32_t(nShards));
+  writeValue(out, int32_t(rows.first));
+  writeValue(out, int32_t(rows.second));
+  writeValue(out, fingerprint);
+
+  std::vector<double> row;
+  for (int i = rows.first; i < rows.second; ++i) {
+    row.clear();
+    for (int j = i + 1; j < n_terms; ++j) {
+      int common = geneSets.intersectionSize(i, j);
+      row.push_back(dm.computeDistance(common, geneSets.size(i), geneSets.size(j)));
+    }
+    out.write(reinterpret_cast<const char*>(row.data()), std::streamsize(row.size() * sizeof(double)));
+  }
+
+  out.write(SHARD_END, 8);
+  writeValue(out, pairsInRows(n_terms, rows.first, rows.second));
+  out.close();
+  if (!out)
+    throw std::runtime_error("failed writing shard file: " + tmpPath);
+
+  // only a fully written shard ever appears under its final name
+  std::remove(path.c_str());
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("cannot move shard file into place: " + path);
+}
+
+bool DistanceShard::isComplete(const std::string& path, int n_terms, int shardIndex,
+                               int nShards, uint64_t fingerprint) {
+  std::ifstream in(path, std::ios::binary);
+  ShardHeader h;
+  if (!in || !readHeader(in, h))
+    return false;
+  if (h.n_terms != n_terms || h.shardIndex != shardIndex || h.nShards != nShards
+        || h.fingerprint != fingerprint)
+    return false;
+
+  const uint64_t pairs = pairsInRows(n_terms, h.rowStart, h.rowEnd);
+  in.seekg(0, std::ios::end);
+  const std::streamoff expected = HEADER_BYTES + std::streamoff(pairs * sizeof(double)) + FOOTER_BYTES;
+  if (in.tellg() != expected)
+    return false;
+
+  char magic[8];
+  uint64_t storedPairs = 0;
+  in.seekg(expected - FOOTER_BYTES, std::ios::beg);
+  return in.read(magic, 8) && std::equal(magic, magic + 8, SHARD_END)
+    && readValue(in, storedPairs) && storedPairs == pairs;
+}
+
+std::pair<int, int> DistanceShard::read(const std::string& path, int n_terms, uint64_t fingerprint,
+                                        const std::function<void(int, int, double)>& fn) {
+  std::ifstream in(path, std::ios::binary);
+  ShardHeader h;
+  if (!in || !readHeader(in, h))
+    throw std::runtime_error("not a distance shard: " + path);
+  if (h.n_terms != n_terms || h.fingerprint != fingerprint)
+    throw std::runtime_error("distance shard was computed from different input: " + path);
+  if (!isComplete(path, n_terms, h.shardIndex, h.nShards, fingerprint))
+    throw std::runtime_error("distance shard is incomplete: " + path);
+
+  std::vector<double> row;
+  for (int i = h.rowStart; i < h.rowEnd; ++i) {
+    row.resize(size_t(n_terms - 1 - i));
+    in.read(reinterpret_cast<char*>(row.data()), std::streamsize(row.size() * sizeof(double)));
+    for (int j = i + 1; j < n_terms; ++j)
+      fn(i, j, row[size_t(j - i - 1)]);
+  }
+  return {h.rowStart, h.rowEnd};
+}
+
+
+// compute one shard of the pairwise scores; returns FALSE when a complete
+// shard for the same input is already on disk
+// [[Rcpp::export]]
+bool writeDistanceShard(Rcpp::CharacterVector geneIDs, std::string distanceMetric,
+                        int shardIndex, int nShards, std::string path) {
+  try {
+    std::vector<std::string> genes = Rcpp::as<std::vector<std::string>>(geneIDs);
+    uint64_t fp = DistanceShard::fingerprint(genes, distanceMetric);
+    if (DistanceShard::isComplete(path, int(genes.size()), shardIndex, nShards, fp))
+      return false;
+
+    GeneSetList geneSets(genes);
+    DistanceMetric dm(distanceMetric, 0.0);
+    dm.setTotalGeneCount(geneSets.universeSize());
+    DistanceShard::write(path, geneSets, dm, shardIndex, nShards, fp);
+    return true;
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
+
+// [[Rcpp::export]]
+bool distanceShardComplete(Rcpp::CharacterVector geneIDs, std::string distanceMetric,
+                           int shardIndex, int nShards, std::string path) {
+  std::vector<std::string> genes = Rcpp::as<std::vector<std::string>>(geneIDs);
+  uint64_t fp = DistanceShard::fingerprint(genes, distanceMetric);
+  return DistanceShard::isComplete(path, int(genes.size()), shardIndex, nShards, fp);
+}
@@ -0,0 +1,41 @@
+//
+//  DistanceShard.h
+//  richCluster
+//
+
+#ifndef DistanceShard_h
+#define DistanceShard_h
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "GeneSetList.h"
+#include "DistanceMetric.h"
+
+// a shard holds the upper-triangle scores (j > i) for a block of rows, so a
+// long computeDistances() run can be split over processes and resumed;
+// files are written to "<path>.tmp" and renamed once complete
+class DistanceShard {
+public:
+  // rows [first, second) of a shard, balanced by number of pairs
+  static std::pair<int, int> rowRange(int n_terms, int shardIndex, int nShards);
+
+  // identifies the input a shard was computed from (gene sets + metric)
+  static uint64_t fingerprint(const std::vector<std::string>& geneIDs,
+                              const std::string& distanceMetric);
+
+  static void write(const std::string& path, const GeneSetList& geneSets,
+                    const DistanceMetric& dm, int shardIndex, int nShards,
+                    uint64_t fingerprint);
+  static bool isComplete(const std::string& path, int n_terms, int shardIndex,
+                         int nShards, uint64_t fingerprint);
+
+  // calls fn(i, j, score) for every pair stored in the shard, returns its row range
+  static std::pair<int, int> read(const std::string& path, int n_terms, uint64_t fingerprint,
+                                  const std::function<void(int, int, double)>& fn);
+};
+
+#endif /* DistanceShard_h */
@@ -0,0 +1,66 @@
+//
+//  DistanceStorage.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <stdexcept>
+#include "DistanceStorage.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedStorage::MappedStorage(size_t, const std::string&) {
+  throw std::runtime_error("memory-mapped distance storage is not supported on Windows");
+}
+MappedStorage::~MappedStorage() {}
+void MappedStorage::adviseSequential() {}
+void MappedStorage::adviseNormal() {}
+
+#else
+
+MappedStorage::MappedStorage(size_t bytes, const std::string& path): length(bytes) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0)
+    throw std::runtime_error("cannot create distance matrix file " + path + ": " + std::strerror(errno));
+  // sparse file, pages only get allocated once a tile is written
+  if (ftruncate(fd, off_t(bytes)) != 0) {
+    int err = errno;
+    close(fd);
+    unlink(path.c_str());
+    throw std::runtime_error("cannot size distance matrix file " + path + ": " + std::strerror(err));
+  }
+  if (bytes > 0)
+    region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  int err = errno;
+  close(fd);
+  unlink(path.c_str()); // the mapping keeps the data alive
+  if (region == MAP_FAILED) {
+    region = nullptr;
+    throw std::runtime_error("cannot map distance matrix file " + path + ": " + std::strerror(err));
+  }
+}
+
+MappedStorage::~MappedStorage() {
+  if (region)
+    munmap(region, length);
+}
+
+void MappedStorage::adviseSequential() {
+  if (region)
+    madvise(region, length, MADV_SEQUENTIAL);
+}
+
+void MappedStorage::adviseNormal() {
+  if (region)
+    madvise(region, length, MADV_NORMAL);
+}
+
+#endif
@@ -0,0 +1,66 @@
+//
+//  DistanceStorage.h
+//  richCluster
+//
+
+#ifndef DistanceStorage_h
+#define DistanceStorage_h
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// where the scores live: "memory" (row-major, in RAM), "mmap" (tiled, in a
+// memory-mapped scratch file at `path`), "sparse" (only pairs sharing a
+// gene, see DistanceMatrix) or "ondemand" (nowhere, recomputed from the gene
+// sets on every read), and how wide each stored score is: "double", "float",
+// "int16" or "uint8". "auto" lets a ResourcePlanner pick.
+struct DistanceStorageSpec {
+  std::string backend = "memory";
+  std::string path;
+  std::string precision = "double";
+};
+
+// raw buffer behind a DistanceMatrix; the matrix decides the layout,
+// the storage only decides where the bytes live
+class DistanceStorage {
+public:
+  virtual ~DistanceStorage() {};
+  virtual void* data() = 0;
+  virtual size_t bytes() const = 0;
+
+  // access pattern hints (no-ops for plain memory)
+  virtual void adviseSequential() {};
+  virtual void adviseNormal() {};
+};
+
+class MemoryStorage : public DistanceStorage {
+public:
+  MemoryStorage(size_t bytes): buffer(bytes) {};
+  void* data() override { return buffer.data(); };
+  size_t bytes() const override { return buffer.size(); };
+
+private:
+  std::vector<unsigned char> buffer;
+};
+
+// file-backed mapping, lets the kernel page cache hold only the touched tiles;
+// the backing file is unlinked right after mapping so it never outlives the run
+class MappedStorage : public DistanceStorage {
+public:
+  MappedStorage(size_t bytes, const std::string& path);
+  ~MappedStorage() override;
+  MappedStorage(const MappedStorage&) = delete;
+  MappedStorage& operator=(const MappedStorage&) = delete;
+
+  void* data() override { return region; };
+  size_t bytes() const override { return length; };
+  void adviseSequential() override;
+  void adviseNormal() override;
+
+private:
+  void* region = nullptr;
+  size_t length = 0;
+};
+
+#endif /* DistanceStorage_h */
@@ -0,0 +1,97 @@
+//
+//  GeneSetList.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include "GeneSetList.h"
+#include "StringUtils.h"
+
+std::vector<int> GeneDictionary::intern(const std::string& geneString) {
+  std::vector<int> genes;
+  for (const std::string& gene : StringUtils::splitStringToUnorderedSet(geneString, ","))
+    genes.push_back(index.emplace(gene, int(index.size())).first->second);
+  std::sort(genes.begin(), genes.end());
+  return genes;
+}
+
+GeneSetList::GeneSetList(std::vector<std::vector<int>> internedSets, size_t dictionarySize):
+  geneSets(std::move(internedSets)), interned(true) {
+  std::vector<int> local(dictionarySize, -1);
+  for (std::vector<int>& genes : geneSets) {
+    for (int& gene : genes) {
+      if (local[gene] < 0) local[gene] = nGenes++;
+      gene = local[gene];
+    }
+    std::sort(genes.begin(), genes.end());
+  }
+}
+
+void GeneSetList::append(const std::vector<std::string>& geneIDs) {
+  if (interned)
+    throw std::logic_error("gene sets interned by a GeneDictionary cannot be appended to");
+  geneSets.reserve(geneSets.size() + geneIDs.size());
+  for (const std::string& geneString : geneIDs) {
+    std::vector<int> genes;
+    for (const std::string& gene : StringUtils::splitStringToUnorderedSet(geneString, ",")) {
+      // intern the gene, new genes get the next free index
+      auto it = geneIndex.emplace(gene, int(geneIndex.size())).first;
+      genes.push_back(it->second);
+    }
+    std::sort(genes.begin(), genes.end());
+    geneSets.push_back(std::move(genes));
+  }
+  nGenes = int(geneIndex.size());
+}
+
+std::vector<int> GeneSetList::collapseDuplicates(int from) {
+  // FNV-1a over the sorted ids; equal hashes are confirmed element-wise
+  auto hash = [](const std::vector<int>& genes) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int gene : genes) {
+      h ^= uint64_t(uint32_t(gene));
+      h *= 1099511628211ULL;
+    }
+    return h ^ genes.size();
+  };
+  std::unordered_map<uint64_t, std::vector<int>> buckets;
+  for (int t = 0; t < from; ++t)
+    buckets[hash(geneSets[t])].push_back(t);
+
+  // unique sets move down to the next free slot, keeping their order
+  std::vector<int> stored;
+  stored.reserve(geneSets.size() - from);
+  int next = from;
+  for (int t = from; t < int(geneSets.size()); ++t) {
+    std::vector<int>& bucket = buckets[hash(geneSets[t])];
+    int row = -1;
+    for (int r : bucket) {
+      if (geneSets[r] == geneSets[t]) { row = r; break; }
+    }
+    if (row < 0) {
+      row = next++;
+      if (row != t) geneSets[row] = std::move(geneSets[t]);
+      bucket.push_back(row);
+    }
+    stored.push_back(row);
+  }
+  geneSets.resize(next);
+  return stored;
+}
+
+// merge-walk over the two sorted gene vectors
+int GeneSetList::intersectionSize(int t1, int t2) const {
+  const std::vector<int>& a = geneSets[t1];
+  const std::vector<int>& b = geneSets[t2];
+  int common = 0;
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i] < b[j]) ++i;
+    else if (b[j] < a[i]) ++j;
+    else { ++common; ++i; ++j; }
+  }
+  return common;
+}
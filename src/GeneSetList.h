@@ -0,0 +1,56 @@
+//
+//  GeneSetList.h
+//  richCluster
+//
+
+#ifndef GeneSetList_h
+#define GeneSetList_h
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// genes interned once for many gene set lists (eg. the jobs of a batch run),
+// so every gene string is hashed once; intern() is not thread-safe
+class GeneDictionary {
+public:
+  // sorted, unique gene ids of one comma-separated geneID string
+  std::vector<int> intern(const std::string& geneString);
+  size_t size() const { return index.size(); };
+
+private:
+  std::unordered_map<std::string, int> index;
+};
+
+// gene sets parsed once from the comma-separated geneID strings; every gene
+// is interned to an int so each term becomes a sorted vector of gene indices
+class GeneSetList {
+public:
+  GeneSetList(const std::vector<std::string>& geneIDs) { append(geneIDs); };
+  // sets already interned by a GeneDictionary; ids are relabeled densely, so
+  // the universe is still only the genes of these terms
+  GeneSetList(std::vector<std::vector<int>> internedSets, size_t dictionarySize);
+  // parse more terms; genes not seen before extend the universe
+  void append(const std::vector<std::string>& geneIDs);
+
+  int size(int t) const { return int(geneSets[t].size()); };
+  const std::vector<int>& genes(int t) const { return geneSets[t]; };
+  int intersectionSize(int t1, int t2) const;
+
+  // drops every set from `from` on that repeats an earlier one (hashing the
+  // sorted ids) and returns, for each of those sets, the set it is now
+  // stored as; sets before `from` are kept as they are
+  std::vector<int> collapseDuplicates(int from = 0);
+
+  // number of unique genes across all terms (the gene universe)
+  int universeSize() const { return nGenes; };
+  size_t n_terms() const { return geneSets.size(); };
+
+private:
+  std::unordered_map<std::string, int> geneIndex; // empty for interned sets
+  std::vector<std::vector<int>> geneSets; // sorted, unique gene indices per term
+  int nGenes = 0;
+  bool interned = false;
+};
+
+#endif /* GeneSetList_h */
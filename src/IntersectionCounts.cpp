@@ -0,0 +1,135 @@
+//
+//  IntersectionCounts.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "IntersectionCounts.h"
+#include "DistanceMetric.h"
+#include "Parallel.h"
+#include "RichCluster.h"
+
+IntersectionCounts::IntersectionCounts(const GeneSetList& geneSets, int threads):
+  universe(geneSets.universeSize()) {
+  const int n = int(geneSets.n_terms());
+  sizes.resize(n);
+  for (int t=0; t<n; ++t) sizes[t] = geneSets.size(t);
+
+  // gene -> sets containing it
+  std::vector<size_t> geneOffsets(universe + 1, 0);
+  for (int t=0; t<n; ++t)
+    for (int g : geneSets.genes(t)) ++geneOffsets[g + 1];
+  for (int g=0; g<universe; ++g) geneOffsets[g + 1] += geneOffsets[g];
+  std::vector<int> sets(geneOffsets[universe]);
+  {
+    std::vector<size_t> fill(geneOffsets.begin(), geneOffsets.end() - 1);
+    for (int t=0; t<n; ++t)
+      for (int g : geneSets.genes(t)) sets[fill[g]++] = t;
+  }
+
+  // every row counts its partners through the index, in blocks of rows
+  constexpr int BLOCK = 64;
+  const int nBlocks = (n + BLOCK - 1) / BLOCK;
+  const int nWorkers = std::max(1, std::min(resolveThreads(threads), nBlocks));
+  std::vector<std::vector<std::pair<int, int32_t>>> rows(n);
+  std::vector<std::vector<int32_t>> common(nWorkers);
+  std::vector<std::vector<int>> touched(nWorkers);
+  parallelFor(nBlocks, nWorkers, [&](int block, int worker) {
+    std::vector<int32_t>& c = common[worker];
+    std::vector<int>& seen = touched[worker];
+    if (c.empty()) c.assign(n, 0);
+    for (int t=block * BLOCK; t<std::min((block + 1) * BLOCK, n); ++t) {
+      for (int g : geneSets.genes(t)) {
+        for (size_t p=geneOffsets[g]; p<geneOffsets[g + 1]; ++p) {
+          const int j = sets[p];
+          if (j != t && c[j]++ == 0)
+            seen.push_back(j);
+        }
+      }
+      std::sort(seen.begin(), seen.end());
+      rows[t].reserve(seen.size());
+      for (int j : seen) {
+        rows[t].push_back({j, c[j]});
+        c[j] = 0;
+      }
+      seen.clear();
+    }
+  });
+
+  offsets.assign(size_t(n) + 1, 0);
+  for (int t=0; t<n; ++t) offsets[t + 1] = offsets[t] + rows[t].size();
+  partners.resize(offsets[n]);
+  counts.resize(offsets[n]);
+  for (int t=0; t<n; ++t) {
+    for (size_t k=0; k<rows[t].size(); ++k) {
+      partners[offsets[t] + k] = rows[t][k].first;
+      counts[offsets[t] + k] = rows[t][k].second;
+    }
+    std::vector<std::pair<int, int32_t>>().swap(rows[t]); // free as we go
+  }
+}
+
+int IntersectionCounts::count(int t1, int t2) const {
+  if (t1 == t2)
+    return sizes[t1];
+  const int* it = std::lower_bound(rowBegin(t1), rowEnd(t1), t2);
+  return (it != rowEnd(t1) && *it == t2) ? countAt(it) : 0;
+}
+
+Rcpp::IntegerMatrix IntersectionCounts::export_r(const std::vector<std::string>& terms,
+                                                 const std::vector<int>& rowOf) const {
+  const int m = int(rowOf.size());
+  std::vector<std::vector<int>> rowTerms(n_terms());
+  for (int a=0; a<m; ++a) rowTerms[rowOf[a]].push_back(a);
+
+  Rcpp::IntegerMatrix out(m, m);
+  for (int a=0; a<m; ++a) {
+    const int r = rowOf[a];
+    for (int b : rowTerms[r]) out(a, b) = sizes[r]; // itself and its duplicates
+    for (const int* p=rowBegin(r); p!=rowEnd(r); ++p)
+      for (int b : rowTerms[*p]) out(a, b) = countAt(p);
+  }
+  Rcpp::CharacterVector names(terms.begin(), terms.end());
+  out.attr("dimnames") = Rcpp::List::create(names, names);
+  out.attr("universe") = universe;
+  return out;
+}
+
+
+
+// the exported function to R: any metric from stored counts (see export_r),
+// the diagonal holding the set sizes; no gene set is needed
+// [[Rcpp::export]]
+Rcpp::NumericMatrix scoresFromCounts(Rcpp::IntegerMatrix counts, std::string distanceMetric,
+                                     int universe) {
+  try {
+    const int m = counts.nrow();
+    if (counts.ncol() != m)
+      throw std::invalid_argument("counts must be a square matrix");
+    for (int a=0; a<m; ++a)
+      if (counts(a, a) < 0 || counts(a, a) > universe)
+        throw std::invalid_argument("set sizes (the diagonal) must be between 0 and the universe size");
+    for (int a=0; a<m; ++a)
+      for (int b=0; b<m; ++b)
+        if (counts(a, b) < 0 || counts(a, b) > std::min(counts(a, a), counts(b, b)))
+          throw std::invalid_argument("counts must be between 0 and the smaller set size");
+    DistanceMetric dm(distanceMetric, 0.0);
+    dm.setTotalGeneCount(universe);
+    Rcpp::NumericMatrix out(m, m);
+    for (int a=0; a<m; ++a) {
+      for (int b=0; b<m; ++b) {
+        out(a, b) = a == b ? richCluster::SAME_TERM_DISTANCE
+                           : dm.computeDistance(counts(a, b), counts(a, a), counts(b, b));
+      }
+    }
+    out.attr("dimnames") = counts.attr("dimnames"); // NULL if it has none
+    return out;
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,50 @@
+//
+//  IntersectionCounts.h
+//  richCluster
+//
+
+#ifndef IntersectionCounts_h
+#define IntersectionCounts_h
+
+#include <Rcpp.h>
+#include <cstdint>
+#include <vector>
+
+#include "GeneSetList.h"
+
+// |A n B| of every pair of gene sets that share a gene, counted once so any
+// number of metrics (each a function of |A n B|, |A|, |B| and N) can be
+// scored without touching the gene sets again. Rows are CSR lists of the
+// partners of a set, ascending, with their int32 counts; every other pair
+// shares nothing. Counting walks a gene -> sets index, so it only visits
+// pairs that do overlap.
+class IntersectionCounts {
+public:
+  IntersectionCounts(const GeneSetList& geneSets, int threads = 1);
+
+  int n_terms() const { return int(sizes.size()); };
+  int size(int t) const { return sizes[t]; };
+  int universeSize() const { return universe; };
+  size_t n_pairs() const { return partners.size() / 2; }; // overlapping pairs
+
+  // |A n B| (the set size if t1 == t2)
+  int count(int t1, int t2) const;
+  // the partners of t, ascending; countAt(p) is the count of partner *p
+  const int* rowBegin(int t) const { return partners.data() + offsets[t]; };
+  const int* rowEnd(int t) const { return partners.data() + offsets[t + 1]; };
+  int countAt(const int* p) const { return counts[p - partners.data()]; };
+
+  // one row/col per input term (rowOf: its set), the set sizes on the
+  // diagonal and the gene universe as attribute "universe"
+  Rcpp::IntegerMatrix export_r(const std::vector<std::string>& terms,
+                               const std::vector<int>& rowOf) const;
+
+private:
+  std::vector<int> sizes;
+  int universe = 0;
+  std::vector<size_t> offsets;
+  std::vector<int> partners;
+  std::vector<int32_t> counts;
+};
+
+#endif /* IntersectionCounts_h */
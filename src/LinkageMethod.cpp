@@ -7,6 +7,7 @@
 
 #include <stdio.h>
 #include "LinkageMethod.h"
+#include <limits>
 
 using Cluster = LinkageMethod::Cluster;
 
@@ -24,7 +25,8 @@ double LinkageMethod::computeLinkage(const Cluster& cluster1, const Cluster& clu
 }
 
 double LinkageMethod::single(const Cluster& cluster1, const Cluster& cluster2) {
-  double minDist = 100; // a default stupid value
+  // scores are not bounded by 1 (eg. -log10 hypergeometric p-values)
+  double minDist = std::numeric_limits<double>::infinity();
   for (auto i = cluster1.begin(); i!= cluster1.end(); ++i) {
     for (auto j = cluster2.begin(); j!= cluster2.end(); ++j) {
       if (i==j) 
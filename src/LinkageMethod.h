@@ -20,7 +20,8 @@ public:
   double computeLinkage(
       const Cluster& cluster1,
       const Cluster& cluster2);
-  double getCutoff() { return cutoff; };
+  double getCutoff() const { return cutoff; };
+  const std::string& getMethod() const { return method; };
   
 private:
   std::string method;
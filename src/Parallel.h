@@ -0,0 +1,65 @@
+//
+//  Parallel.h
+//  richCluster
+//
+
+#ifndef Parallel_h
+#define Parallel_h
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// threads <= 0 means one per hardware thread
+inline int resolveThreads(int threads) {
+  if (threads > 0)
+    return threads;
+  return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+// runs fn(task, worker) for every task in [0, nTasks) on up to `threads` threads;
+// tasks are handed out one at a time, so uneven tasks balance themselves.
+// worker is in [0, threads) and lets callers keep per-thread buffers.
+// fn must not touch the R API (no Rcout, no Rcpp objects) unless threads == 1.
+// The first exception thrown by a task is rethrown here after all workers stopped.
+inline void parallelFor(int nTasks, int threads,
+                        const std::function<void(int task, int worker)>& fn) {
+  threads = std::max(1, std::min(resolveThreads(threads), nTasks));
+  if (threads == 1) {
+    for (int task = 0; task < nTasks; ++task)
+      fn(task, 0);
+    return;
+  }
+
+  std::atomic<int> next(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto work = [&](int worker) {
+    for (int task = next++; task < nTasks && !failed; task = next++) {
+      try {
+        fn(task, worker);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) error = std::current_exception();
+        failed = true;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (int w = 1; w < threads; ++w)
+    workers.emplace_back(work, w);
+  work(0);
+  for (std::thread& t : workers)
+    t.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+#endif /* Parallel_h */
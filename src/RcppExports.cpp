@@ -10,6 +10,287 @@ Rcpp::Rostream<true>&  Rcpp::Rcout = Rcpp::Rcpp_cout_get();
 Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
+// runBootstrapStability
+Rcpp::List runBootstrapStability(Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs, std::string distanceMetric, double distanceCutoff, std::string linkageMethod, double linkageCutoff, Rcpp::List referenceClusters, Rcpp::List options);
+RcppExport SEXP _richCluster_runBootstrapStability(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffSEXP, SEXP referenceClustersSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< double >::type distanceCutoff(distanceCutoffSEXP);
+    Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
+    Rcpp::traits::input_parameter< double >::type linkageCutoff(linkageCutoffSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type referenceClusters(referenceClustersSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(runBootstrapStability(terms, geneIDs, distanceMetric, distanceCutoff, linkageMethod, linkageCutoff, referenceClusters, options));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runRichClusterBatch
+Rcpp::List runRichClusterBatch(Rcpp::List jobs, std::string distanceMetric, double distanceCutoff, std::string linkageMethod, double linkageCutoff, Rcpp::List options);
+RcppExport SEXP _richCluster_runRichClusterBatch(SEXP jobsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type jobs(jobsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< double >::type distanceCutoff(distanceCutoffSEXP);
+    Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
+    Rcpp::traits::input_parameter< double >::type linkageCutoff(linkageCutoffSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(runRichClusterBatch(jobs, distanceMetric, distanceCutoff, linkageMethod, linkageCutoff, options));
+    return rcpp_result_gen;
+END_RCPP
+}
+// compareClusterMemberships
+Rcpp::List compareClusterMemberships(std::vector<std::string> termsA, std::vector<int> clustersA, std::vector<std::string> termsB, std::vector<int> clustersB);
+RcppExport SEXP _richCluster_compareClusterMemberships(SEXP termsASEXP, SEXP clustersASEXP, SEXP termsBSEXP, SEXP clustersBSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type termsA(termsASEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type clustersA(clustersASEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type termsB(termsBSEXP);
+    Rcpp::traits::input_parameter< std::vector<int> >::type clustersB(clustersBSEXP);
+    rcpp_result_gen = Rcpp::wrap(compareClusterMemberships(termsA, clustersA, termsB, clustersB));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jobProgress
+Rcpp::List jobProgress(SEXP job);
+RcppExport SEXP _richCluster_jobProgress(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(jobProgress(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jobCancel
+void jobCancel(SEXP job);
+RcppExport SEXP _richCluster_jobCancel(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    jobCancel(job);
+    return R_NilValue;
+END_RCPP
+}
+// jobWait
+bool jobWait(SEXP job, double seconds);
+RcppExport SEXP _richCluster_jobWait(SEXP jobSEXP, SEXP secondsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    Rcpp::traits::input_parameter< double >::type seconds(secondsSEXP);
+    rcpp_result_gen = Rcpp::wrap(jobWait(job, seconds));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jobResult
+Rcpp::List jobResult(SEXP job);
+RcppExport SEXP _richCluster_jobResult(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(jobResult(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// jobSession
+SEXP jobSession(SEXP job);
+RcppExport SEXP _richCluster_jobSession(SEXP jobSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type job(jobSEXP);
+    rcpp_result_gen = Rcpp::wrap(jobSession(job));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runRichClusterMetrics
+Rcpp::List runRichClusterMetrics(std::vector<std::string> terms, std::vector<std::string> geneIDs, std::vector<std::string> metrics, std::vector<double> distanceCutoffs, std::string linkageMethod, std::vector<double> linkageCutoffs, Rcpp::List options);
+RcppExport SEXP _richCluster_runRichClusterMetrics(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP metricsSEXP, SEXP distanceCutoffsSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffsSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type metrics(metricsSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type distanceCutoffs(distanceCutoffsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type linkageCutoffs(linkageCutoffsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(runRichClusterMetrics(terms, geneIDs, metrics, distanceCutoffs, linkageMethod, linkageCutoffs, options));
+    return rcpp_result_gen;
+END_RCPP
+}
+// createClusterSession
+SEXP createClusterSession(Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs, std::string distanceMetric, double distanceCutoff, std::string linkageMethod, double linkageCutoff, Rcpp::List options);
+RcppExport SEXP _richCluster_createClusterSession(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< double >::type distanceCutoff(distanceCutoffSEXP);
+    Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
+    Rcpp::traits::input_parameter< double >::type linkageCutoff(linkageCutoffSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(createClusterSession(terms, geneIDs, distanceMetric, distanceCutoff, linkageMethod, linkageCutoff, options));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionAddTerms
+Rcpp::List sessionAddTerms(SEXP session, Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs);
+RcppExport SEXP _richCluster_sessionAddTerms(SEXP sessionSEXP, SEXP termsSEXP, SEXP geneIDsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionAddTerms(session, terms, geneIDs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionResult
+Rcpp::List sessionResult(SEXP session, bool exportDistances);
+RcppExport SEXP _richCluster_sessionResult(SEXP sessionSEXP, SEXP exportDistancesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< bool >::type exportDistances(exportDistancesSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionResult(session, exportDistances));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionRelease
+void sessionRelease(SEXP session);
+RcppExport SEXP _richCluster_sessionRelease(SEXP sessionSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    sessionRelease(session);
+    return R_NilValue;
+END_RCPP
+}
+// sessionClusterSubset
+Rcpp::List sessionClusterSubset(SEXP session, Rcpp::IntegerVector indices, bool exportDistances);
+RcppExport SEXP _richCluster_sessionClusterSubset(SEXP sessionSEXP, SEXP indicesSEXP, SEXP exportDistancesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type indices(indicesSEXP);
+    Rcpp::traits::input_parameter< bool >::type exportDistances(exportDistancesSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionClusterSubset(session, indices, exportDistances));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionValid
+bool sessionValid(SEXP session);
+RcppExport SEXP _richCluster_sessionValid(SEXP sessionSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionValid(session));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionSubmatrix
+Rcpp::NumericMatrix sessionSubmatrix(SEXP session, Rcpp::CharacterVector terms);
+RcppExport SEXP _richCluster_sessionSubmatrix(SEXP sessionSEXP, SEXP termsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionSubmatrix(session, terms));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionTopNeighbours
+Rcpp::DataFrame sessionTopNeighbours(SEXP session, std::string term, int k);
+RcppExport SEXP _richCluster_sessionTopNeighbours(SEXP sessionSEXP, SEXP termSEXP, SEXP kSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< std::string >::type term(termSEXP);
+    Rcpp::traits::input_parameter< int >::type k(kSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionTopNeighbours(session, term, k));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionEdgeList
+Rcpp::List sessionEdgeList(SEXP session, Rcpp::Nullable<Rcpp::CharacterVector> terms, double minScore, int topK);
+RcppExport SEXP _richCluster_sessionEdgeList(SEXP sessionSEXP, SEXP termsSEXP, SEXP minScoreSEXP, SEXP topKSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::CharacterVector> >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< double >::type minScore(minScoreSEXP);
+    Rcpp::traits::input_parameter< int >::type topK(topKSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionEdgeList(session, terms, minScore, topK));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionDendrogram
+Rcpp::List sessionDendrogram(SEXP session, std::string linkageMethod, bool seeds);
+RcppExport SEXP _richCluster_sessionDendrogram(SEXP sessionSEXP, SEXP linkageMethodSEXP, SEXP seedsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
+    Rcpp::traits::input_parameter< bool >::type seeds(seedsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionDendrogram(session, linkageMethod, seeds));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sessionClusterSummary
+Rcpp::DataFrame sessionClusterSummary(SEXP session, Rcpp::CharacterVector terms, Rcpp::List clusters, Rcpp::NumericMatrix values, std::vector<std::string> valueNames, int threads);
+RcppExport SEXP _richCluster_sessionClusterSummary(SEXP sessionSEXP, SEXP termsSEXP, SEXP clustersSEXP, SEXP valuesSEXP, SEXP valueNamesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type session(sessionSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type clusters(clustersSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type values(valuesSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type valueNames(valueNamesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sessionClusterSummary(session, terms, clusters, values, valueNames, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// denseClusterSummary
+Rcpp::DataFrame denseClusterSummary(Rcpp::NumericMatrix scores, Rcpp::CharacterVector terms, Rcpp::List clusters, Rcpp::NumericMatrix values, std::vector<std::string> valueNames, double edgeCutoff, int threads);
+RcppExport SEXP _richCluster_denseClusterSummary(SEXP scoresSEXP, SEXP termsSEXP, SEXP clustersSEXP, SEXP valuesSEXP, SEXP valueNamesSEXP, SEXP edgeCutoffSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type scores(scoresSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type terms(termsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type clusters(clustersSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type values(valuesSEXP);
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type valueNames(valueNamesSEXP);
+    Rcpp::traits::input_parameter< double >::type edgeCutoff(edgeCutoffSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(denseClusterSummary(scores, terms, clusters, values, valueNames, edgeCutoff, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // runDavidClustering
 Rcpp::List runDavidClustering(Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs, double similarityThreshold, int initialGroupMembership, int finalGroupMembership, double multipleLinkageThreshold);
 RcppExport SEXP _richCluster_runDavidClustering(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP similarityThresholdSEXP, SEXP initialGroupMembershipSEXP, SEXP finalGroupMembershipSEXP, SEXP multipleLinkageThresholdSEXP) {
@@ -26,9 +307,66 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// writeDistanceShard
+bool writeDistanceShard(Rcpp::CharacterVector geneIDs, std::string distanceMetric, int shardIndex, int nShards, std::string path);
+RcppExport SEXP _richCluster_writeDistanceShard(SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP shardIndexSEXP, SEXP nShardsSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< int >::type shardIndex(shardIndexSEXP);
+    Rcpp::traits::input_parameter< int >::type nShards(nShardsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(writeDistanceShard(geneIDs, distanceMetric, shardIndex, nShards, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// distanceShardComplete
+bool distanceShardComplete(Rcpp::CharacterVector geneIDs, std::string distanceMetric, int shardIndex, int nShards, std::string path);
+RcppExport SEXP _richCluster_distanceShardComplete(SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP shardIndexSEXP, SEXP nShardsSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< int >::type shardIndex(shardIndexSEXP);
+    Rcpp::traits::input_parameter< int >::type nShards(nShardsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(distanceShardComplete(geneIDs, distanceMetric, shardIndex, nShards, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scoresFromCounts
+Rcpp::NumericMatrix scoresFromCounts(Rcpp::IntegerMatrix counts, std::string distanceMetric, int universe);
+RcppExport SEXP _richCluster_scoresFromCounts(SEXP countsSEXP, SEXP distanceMetricSEXP, SEXP universeSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type counts(countsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< int >::type universe(universeSEXP);
+    rcpp_result_gen = Rcpp::wrap(scoresFromCounts(counts, distanceMetric, universe));
+    return rcpp_result_gen;
+END_RCPP
+}
+// planRichCluster
+Rcpp::List planRichCluster(Rcpp::CharacterVector geneIDs, std::string distanceMetric, double distanceCutoff, Rcpp::List options);
+RcppExport SEXP _richCluster_planRichCluster(SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< double >::type distanceCutoff(distanceCutoffSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(planRichCluster(geneIDs, distanceMetric, distanceCutoff, options));
+    return rcpp_result_gen;
+END_RCPP
+}
 // runRichCluster
-Rcpp::List runRichCluster(Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs, std::string distanceMetric, double distanceCutoff, std::string linkageMethod, double linkageCutoff);
-RcppExport SEXP _richCluster_runRichCluster(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffSEXP) {
+SEXP runRichCluster(Rcpp::CharacterVector terms, Rcpp::CharacterVector geneIDs, std::string distanceMetric, double distanceCutoff, std::string linkageMethod, double linkageCutoff, Rcpp::List options);
+RcppExport SEXP _richCluster_runRichCluster(SEXP termsSEXP, SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP distanceCutoffSEXP, SEXP linkageMethodSEXP, SEXP linkageCutoffSEXP, SEXP optionsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -38,14 +376,56 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< double >::type distanceCutoff(distanceCutoffSEXP);
     Rcpp::traits::input_parameter< std::string >::type linkageMethod(linkageMethodSEXP);
     Rcpp::traits::input_parameter< double >::type linkageCutoff(linkageCutoffSEXP);
-    rcpp_result_gen = Rcpp::wrap(runRichCluster(terms, geneIDs, distanceMetric, distanceCutoff, linkageMethod, linkageCutoff));
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(runRichCluster(terms, geneIDs, distanceMetric, distanceCutoff, linkageMethod, linkageCutoff, options));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sketchScores
+Rcpp::List sketchScores(Rcpp::CharacterVector geneIDs, std::string distanceMetric, std::vector<double> cutoffs, std::vector<double> probabilities, Rcpp::List options);
+RcppExport SEXP _richCluster_sketchScores(SEXP geneIDsSEXP, SEXP distanceMetricSEXP, SEXP cutoffsSEXP, SEXP probabilitiesSEXP, SEXP optionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type geneIDs(geneIDsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type distanceMetric(distanceMetricSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type cutoffs(cutoffsSEXP);
+    Rcpp::traits::input_parameter< std::vector<double> >::type probabilities(probabilitiesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type options(optionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sketchScores(geneIDs, distanceMetric, cutoffs, probabilities, options));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_richCluster_runBootstrapStability", (DL_FUNC) &_richCluster_runBootstrapStability, 8},
+    {"_richCluster_runRichClusterBatch", (DL_FUNC) &_richCluster_runRichClusterBatch, 6},
+    {"_richCluster_compareClusterMemberships", (DL_FUNC) &_richCluster_compareClusterMemberships, 4},
+    {"_richCluster_jobProgress", (DL_FUNC) &_richCluster_jobProgress, 1},
+    {"_richCluster_jobCancel", (DL_FUNC) &_richCluster_jobCancel, 1},
+    {"_richCluster_jobWait", (DL_FUNC) &_richCluster_jobWait, 2},
+    {"_richCluster_jobResult", (DL_FUNC) &_richCluster_jobResult, 1},
+    {"_richCluster_jobSession", (DL_FUNC) &_richCluster_jobSession, 1},
+    {"_richCluster_runRichClusterMetrics", (DL_FUNC) &_richCluster_runRichClusterMetrics, 7},
+    {"_richCluster_createClusterSession", (DL_FUNC) &_richCluster_createClusterSession, 7},
+    {"_richCluster_sessionAddTerms", (DL_FUNC) &_richCluster_sessionAddTerms, 3},
+    {"_richCluster_sessionResult", (DL_FUNC) &_richCluster_sessionResult, 2},
+    {"_richCluster_sessionRelease", (DL_FUNC) &_richCluster_sessionRelease, 1},
+    {"_richCluster_sessionClusterSubset", (DL_FUNC) &_richCluster_sessionClusterSubset, 3},
+    {"_richCluster_sessionValid", (DL_FUNC) &_richCluster_sessionValid, 1},
+    {"_richCluster_sessionSubmatrix", (DL_FUNC) &_richCluster_sessionSubmatrix, 2},
+    {"_richCluster_sessionTopNeighbours", (DL_FUNC) &_richCluster_sessionTopNeighbours, 3},
+    {"_richCluster_sessionEdgeList", (DL_FUNC) &_richCluster_sessionEdgeList, 4},
+    {"_richCluster_sessionDendrogram", (DL_FUNC) &_richCluster_sessionDendrogram, 3},
+    {"_richCluster_sessionClusterSummary", (DL_FUNC) &_richCluster_sessionClusterSummary, 6},
+    {"_richCluster_denseClusterSummary", (DL_FUNC) &_richCluster_denseClusterSummary, 7},
     {"_richCluster_runDavidClustering", (DL_FUNC) &_richCluster_runDavidClustering, 6},
-    {"_richCluster_runRichCluster", (DL_FUNC) &_richCluster_runRichCluster, 6},
+    {"_richCluster_writeDistanceShard", (DL_FUNC) &_richCluster_writeDistanceShard, 5},
+    {"_richCluster_distanceShardComplete", (DL_FUNC) &_richCluster_distanceShardComplete, 5},
+    {"_richCluster_scoresFromCounts", (DL_FUNC) &_richCluster_scoresFromCounts, 3},
+    {"_richCluster_planRichCluster", (DL_FUNC) &_richCluster_planRichCluster, 4},
+    {"_richCluster_runRichCluster", (DL_FUNC) &_richCluster_runRichCluster, 7},
+    {"_richCluster_sketchScores", (DL_FUNC) &_richCluster_sketchScores, 5},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,295 @@
+//
+//  ResourcePlanner.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "ResourcePlanner.h"
+#include "DistanceMetric.h"
+#include "Parallel.h"
+#include "SystemMemory.h"
+
+namespace {
+
+constexpr int SAMPLE_PAIRS = 20000;
+constexpr int LOCAL_BLOCK_TERMS = 2048;   // as richCluster's dense component blocks
+constexpr int TILE_SIZE = 64;             // as DistanceMatrix's tiles
+constexpr double DISK_BYTES_PER_SECOND = 1e9;
+#ifdef _WIN32
+constexpr const char* FALLBACK = "ondemand"; // MappedStorage is POSIX only
+#else
+constexpr const char* FALLBACK = "mmap";
+#endif
+
+double gigabytes(double bytes) { return bytes / (1024.0 * 1024.0 * 1024.0); }
+
+} // namespace
+
+double ResourcePlanner::bytesPerScore(const std::string& precision) {
+  if (precision == "double") return 8;
+  if (precision == "float") return 4;
+  if (precision == "int16") return 2;
+  if (precision == "uint8") return 1;
+  throw std::invalid_argument("unsupported distance precision: " + precision);
+}
+
+ResourcePlanner::ResourcePlanner(const GeneSetList& geneSets, const std::string& distanceMetric,
+                                 double distanceCutoff, const Settings& settings):
+  used(settings), n_terms(int(geneSets.n_terms())), n_genes(geneSets.universeSize()) {
+  used.threads = resolveThreads(settings.threads);
+  const double n = n_terms;
+  const double pairs = n * (n - 1) / 2;
+
+  double totalGenes = 0;
+  for (int t=0; t<n_terms; ++t) {
+    totalGenes += geneSets.size(t);
+    maxSetSize = std::max(maxSetSize, double(geneSets.size(t)));
+  }
+  meanSetSize = n_terms ? totalGenes / n : 0;
+
+  // score a fixed random sample of pairs (or all of them if there are fewer)
+  if (n_terms >= 2) {
+    DistanceMetric dm(distanceMetric, distanceCutoff);
+    dm.setTotalGeneCount(n_genes);
+    std::mt19937_64 rng(1);
+    const int samples = int(std::min(pairs, double(SAMPLE_PAIRS)));
+    int overlaps = 0, edges = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int s=0; s<samples; ++s) {
+      int i, j;
+      if (pairs <= SAMPLE_PAIRS) { // every pair once
+        i = 0;
+        int k = s;
+        while (k >= n_terms - 1 - i) { k -= n_terms - 1 - i; ++i; }
+        j = i + 1 + k;
+      } else {
+        i = int(rng() % uint64_t(n_terms));
+        j = int(rng() % uint64_t(n_terms - 1));
+        if (j >= i) ++j;
+      }
+      int common = geneSets.intersectionSize(i, j);
+      double score = dm.computeDistance(common, geneSets.size(i), geneSets.size(j));
+      overlaps += common > 0;
+      edges += score >= distanceCutoff;
+    }
+    secondsPerPair = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()
+      / samples;
+    overlapDensity = double(overlaps) / samples;
+    edgeDensity = double(edges) / samples;
+  }
+
+  available = availableMemoryBytes();
+  budget = settings.memoryLimit > 0 ? settings.memoryLimit : 0.8 * available;
+
+  // shared by every strategy: gene sets, adjacency (or the kNN heaps of
+  // every thread), component blocks, R export
+  const double threads = used.threads;
+  const double localBlock = std::min(n, double(LOCAL_BLOCK_TERMS));
+  const double edgeBytes = settings.knn > 0
+    ? std::min(edgeDensity * pairs, n * settings.knn) * BYTES_PER_EDGE
+      + threads * n * (24 + settings.knn * 16.0)
+    : edgeDensity * pairs * BYTES_PER_EDGE;
+  const double base = totalGenes * 4 + n * 64 + n_genes * 64.0
+    + edgeBytes
+    + threads * localBlock * localBlock * 8
+    + (settings.exportDistances ? n * n * 8 : 0);
+  const double scoring = pairs * secondsPerPair / threads;
+
+  const double bytes = bytesPerScore(settings.precision);
+  const Strategy onDemand{"ondemand", "ondemand", settings.precision, base, 0, scoring};
+  if (settings.knn > 0)
+    strategies.push_back(onDemand);
+  strategies.push_back({"dense", "memory", settings.precision, base + n * n * bytes, 0, scoring});
+  strategies.push_back({"sparse", "sparse", settings.precision,
+                        base + overlapDensity * pairs * BYTES_PER_EDGE, 0, scoring});
+  if (settings.precision == "double") {
+    bool bounded = std::isfinite(DistanceMetric::scoreRange(distanceMetric).second);
+    std::string packed = bounded ? "int16" : "float";
+    strategies.push_back({"packed", "memory", packed, base + n * n * bytesPerScore(packed), 0, scoring});
+  }
+#ifndef _WIN32
+  const double tiles = std::ceil(n / TILE_SIZE);
+  const double disk = tiles * tiles * TILE_SIZE * TILE_SIZE * bytes;
+  strategies.push_back({"mmap", "mmap", settings.precision,
+                        base + threads * 2 * TILE_SIZE * n * bytes, disk,
+                        scoring + disk / DISK_BYTES_PER_SECOND});
+#endif
+  // never picked by "auto" without a kNN graph: linkage reads rescore pairs
+  if (settings.knn <= 0)
+    strategies.push_back(onDemand);
+
+  if (settings.exportDistances && budget > 0 && n * n * 8 > budget) {
+    std::ostringstream note;
+    note << "the exported distance_matrix alone needs " << gigabytes(n * n * 8)
+         << " GB; set keep_distance_matrix = FALSE (export_distances) to leave it out";
+    notes.push_back(note.str());
+  }
+}
+
+DistanceStorageSpec ResourcePlanner::choose(const std::string& storage) {
+  if (storage == "auto") {
+    // without a known budget everything fits
+    for (size_t s=0; s<strategies.size(); ++s)
+      if (strategies[s].name == FALLBACK) chosen = int(s);
+    for (size_t s=0; s<strategies.size(); ++s) {
+      if (strategies[s].name == "ondemand" && used.knn <= 0)
+        continue;
+      if (budget <= 0 || strategies[s].memory <= budget) {
+        chosen = int(s);
+        break;
+      }
+    }
+    if (budget > 0 && strategies[chosen].memory > budget) {
+#ifdef _WIN32
+      notes.push_back("no strategy fits the memory budget, using ondemand "
+                      "(memory-mapped storage is not available on Windows)");
+#else
+      notes.push_back("no strategy fits the memory budget, using mmap");
+#endif
+    }
+    if (strategies[chosen].precision != used.precision) {
+      std::ostringstream note;
+      note << "scores are stored as " << strategies[chosen].precision << " instead of "
+           << used.precision << " to fit the memory budget, which rounds them; "
+           << "give storage = \"memory\" to keep " << used.precision;
+      notes.push_back(note.str());
+    }
+  } else {
+#ifdef _WIN32
+    if (storage == "mmap")
+      throw std::invalid_argument("memory-mapped distance storage is not supported on Windows");
+#endif
+    chosen = -1;
+    for (size_t s=0; s<strategies.size(); ++s) {
+      if (strategies[s].backend == storage && strategies[s].precision == used.precision) {
+        chosen = int(s);
+        break;
+      }
+    }
+    if (chosen < 0)
+      throw std::invalid_argument("unsupported distance storage: " + storage);
+    if (budget > 0 && strategies[chosen].memory > budget) {
+      std::ostringstream note;
+      note << "storage '" << storage << "' needs about " << gigabytes(strategies[chosen].memory)
+           << " GB, more than the " << gigabytes(budget) << " GB budget";
+      notes.push_back(note.str());
+    }
+  }
+
+  DistanceStorageSpec spec;
+  spec.backend = strategies[chosen].backend;
+  spec.precision = strategies[chosen].precision;
+  spec.path = used.storagePath;
+  return spec;
+}
+
+std::string ResourcePlanner::summary() const {
+  const Strategy& s = strategies[chosen];
+  std::ostringstream out;
+  out.precision(3);
+  out << "Plan: " << s.name << " (" << s.backend << ", " << s.precision << "), about "
+      << gigabytes(s.memory) << " GB memory";
+  if (s.disk > 0)
+    out << " + " << gigabytes(s.disk) << " GB disk";
+  out << ", " << s.seconds << " s scoring on " << used.threads << (used.threads == 1 ? " thread" : " threads");
+  if (budget > 0)
+    out << " (budget " << gigabytes(budget) << " GB)";
+  return out.str();
+}
+
+Rcpp::List ResourcePlanner::export_r() const {
+  const int k = int(strategies.size());
+  Rcpp::CharacterVector name(k), backend(k), precision(k);
+  Rcpp::NumericVector memory(k), disk(k), seconds(k);
+  Rcpp::LogicalVector fits(k);
+  for (int s=0; s<k; ++s) {
+    name[s] = strategies[s].name;
+    backend[s] = strategies[s].backend;
+    precision[s] = strategies[s].precision;
+    memory[s] = gigabytes(strategies[s].memory);
+    disk[s] = gigabytes(strategies[s].disk);
+    seconds[s] = strategies[s].seconds;
+    fits[s] = budget <= 0 || strategies[s].memory <= budget;
+  }
+  return Rcpp::List::create(
+    Rcpp::_["strategies"] = Rcpp::DataFrame::create(
+      Rcpp::_["Strategy"]     = name,
+      Rcpp::_["Storage"]      = backend,
+      Rcpp::_["Precision"]    = precision,
+      Rcpp::_["MemoryGB"]     = memory,
+      Rcpp::_["DiskGB"]       = disk,
+      Rcpp::_["ScoreSeconds"] = seconds,
+      Rcpp::_["Fits"]         = fits,
+      Rcpp::_["stringsAsFactors"] = false
+    ),
+    Rcpp::_["chosen"]          = strategies[chosen].name,
+    Rcpp::_["storage"]         = strategies[chosen].backend,
+    Rcpp::_["precision"]       = strategies[chosen].precision,
+    Rcpp::_["n_terms"]         = n_terms,
+    Rcpp::_["n_genes"]         = n_genes,
+    Rcpp::_["mean_set_size"]   = meanSetSize,
+    Rcpp::_["max_set_size"]    = maxSetSize,
+    Rcpp::_["overlap_density"] = overlapDensity,
+    Rcpp::_["edge_density"]    = edgeDensity,
+    Rcpp::_["threads"]         = used.threads,
+    Rcpp::_["available_gb"]    = available > 0 ? gigabytes(available) : NA_REAL,
+    Rcpp::_["budget_gb"]       = budget > 0 ? gigabytes(budget) : NA_REAL,
+    Rcpp::_["notes"]           = notes,
+    Rcpp::_["summary"]         = summary()
+  );
+}
+
+ResourcePlanner::Settings ResourcePlanner::settings(const Rcpp::List& options) {
+  Settings settings;
+  if (options.containsElementNamed("threads"))
+    settings.threads = Rcpp::as<int>(options["threads"]);
+  if (options.containsElementNamed("export_distances"))
+    settings.exportDistances = Rcpp::as<bool>(options["export_distances"]);
+  if (options.containsElementNamed("memory_limit"))
+    settings.memoryLimit = Rcpp::as<double>(options["memory_limit"]);
+  if (options.containsElementNamed("precision"))
+    settings.precision = Rcpp::as<std::string>(options["precision"]);
+  if (options.containsElementNamed("storage_path"))
+    settings.storagePath = Rcpp::as<std::string>(options["storage_path"]);
+  if (options.containsElementNamed("knn"))
+    settings.knn = Rcpp::as<int>(options["knn"]);
+  return settings;
+}
+
+
+Rcpp::List ResourcePlanner::plan(const std::vector<std::string>& geneIDs,
+                                 const std::string& distanceMetric, double distanceCutoff,
+                                 const Rcpp::List& options) {
+  GeneSetList geneSets(geneIDs);
+  // as richCluster::create(): identical gene sets are scored once
+  if (options.containsElementNamed("collapse_duplicates")
+        && Rcpp::as<bool>(options["collapse_duplicates"]))
+    geneSets.collapseDuplicates();
+  ResourcePlanner planner(geneSets, distanceMetric, distanceCutoff, settings(options));
+  planner.choose(options.containsElementNamed("storage")
+                 ? Rcpp::as<std::string>(options["storage"]) : "auto");
+  return planner.export_r();
+}
+
+
+
+// the exported function to R: the plan alone (a dry run), nothing is scored
+// [[Rcpp::export]]
+Rcpp::List planRichCluster(Rcpp::CharacterVector geneIDs,
+                           std::string distanceMetric, double distanceCutoff,
+                           Rcpp::List options = Rcpp::List::create()) {
+  try {
+    return ResourcePlanner::plan(Rcpp::as<std::vector<std::string>>(geneIDs),
+                                 distanceMetric, distanceCutoff, options);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
@@ -0,0 +1,78 @@
+//
+//  ResourcePlanner.h
+//  richCluster
+//
+
+#ifndef ResourcePlanner_h
+#define ResourcePlanner_h
+
+#include <Rcpp.h>
+#include <string>
+#include <vector>
+
+#include "DistanceStorage.h"
+#include "GeneSetList.h"
+
+// Preflight estimate of peak memory, disk and scoring time for every way of
+// storing the scores, before anything n^2 is allocated:
+//   dense   row-major in RAM at the requested precision
+//   sparse  only the pairs sharing a gene (exact, see DistanceMatrix)
+//   packed  row-major in RAM at int16 ("float" for unbounded metrics)
+//   mmap    tiled scratch file, RAM holds only the tiles in use
+//   ondemand no scores at all, every read rescores the pair
+// Overlap and edge densities and the time per pair come from scoring a
+// fixed random sample of pairs. choose("auto") takes the first strategy in
+// that order that fits the memory budget, or mmap if none does (ondemand on
+// Windows, which has no mmap strategy); a kNN graph (knn > 0) keeps memory
+// O(n * knn), so then ondemand comes first.
+class ResourcePlanner {
+public:
+  struct Settings {
+    int threads = 1;
+    bool exportDistances = true;  // the dense R matrix counts towards the peak
+    double memoryLimit = 0;       // bytes; <= 0 uses 80% of the available memory
+    std::string precision = "double";
+    std::string storagePath;      // for mmap
+    int knn = 0;                  // kNN graph: at most n * knn edges
+  };
+
+  ResourcePlanner(const GeneSetList& geneSets, const std::string& distanceMetric,
+                  double distanceCutoff, const Settings& settings);
+
+  // storage = "auto" picks a strategy, any other backend is taken as given
+  DistanceStorageSpec choose(const std::string& storage);
+  // one line for the progress output, then the notes (eg. fallbacks) of choose()
+  std::string summary() const;
+  const std::vector<std::string>& getNotes() const { return notes; };
+  Rcpp::List export_r() const;
+
+  // adjacency list bytes per stored edge at the CSR build peak: buffer,
+  // both rows and the final row entries
+  static constexpr double BYTES_PER_EDGE = 72;
+
+  static Settings settings(const Rcpp::List& options);
+  // the dry run: plan for options$storage (default "auto") without scoring
+  static Rcpp::List plan(const std::vector<std::string>& geneIDs,
+                         const std::string& distanceMetric, double distanceCutoff,
+                         const Rcpp::List& options);
+
+private:
+  struct Strategy {
+    std::string name, backend, precision;
+    double memory, disk, seconds; // bytes, bytes, scoring seconds
+  };
+
+  Settings used;
+  int n_terms, n_genes;
+  double meanSetSize = 0, maxSetSize = 0;
+  double overlapDensity = 0, edgeDensity = 0; // share of pairs
+  double secondsPerPair = 0;
+  double available, budget;
+  std::vector<Strategy> strategies;
+  int chosen = 0;
+  std::vector<std::string> notes;
+
+  static double bytesPerScore(const std::string& precision);
+};
+
+#endif /* ResourcePlanner_h */
@@ -7,156 +7,1182 @@
 
 #include <stdio.h>
 #include <string>
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
 #include "RichCluster.h"
 #include "StringUtils.h"
+#include "DistanceShard.h"
+#include "Parallel.h"
+#include "ResourcePlanner.h"
+#include "ClusterJob.h"
 #include <Rcpp.h>
 
+namespace {
+
+using Scored = std::pair<double, int>;
+
+// higher score first, ties by index, so the k best never depend on the order
+// candidates were offered in (or on the number of threads)
+bool betterScored(const Scored& x, const Scored& y) {
+  return x.first > y.first || (x.first == y.first && x.second < y.second);
+}
+
+// bounded min-heap of the k best offered so far; the root is the worst of them
+void offerScored(std::vector<Scored>& heap, int k, const Scored& candidate) {
+  if (int(heap.size()) < k) {
+    heap.push_back(candidate);
+    std::push_heap(heap.begin(), heap.end(), betterScored);
+  } else if (betterScored(candidate, heap.front())) {
+    std::pop_heap(heap.begin(), heap.end(), betterScored);
+    heap.back() = candidate;
+    std::push_heap(heap.begin(), heap.end(), betterScored);
+  }
+}
+
+} // namespace
+
 void richCluster::computeDistances() {
-  Rcpp::Rcout << "Computing distances..." << std::endl;
-  int totalGeneCount = StringUtils::countUniqueElements(geneIDs);
+  if (verbose)
+    Rcpp::Rcout << "Computing distances..." << std::endl;
   
-  for (int i=0; i<n_terms; ++i) {
-    // the unordered set of term1 genes
-    std::unordered_set<std::string> term1_genes = StringUtils::splitStringToUnorderedSet(geneIDs[i], ",");
+  // walk the upper triangle block by block, mirroring every block, so (tiled)
+  // storage is written one tile pair at a time; rows of blocks are spread
+  // over the threads, each collecting its own edges
+  const int B = distMatrix.blockSize();
+  const int nBlocks = (n_terms + B - 1) / B;
+  const int nWorkers = std::max(1, std::min(resolveThreads(threads), nBlocks));
+  std::vector<AdjacencyList::EdgeBuffer> edges(nWorkers);
+  std::vector<double> maxError(nWorkers, 0.0);
+  // sparse storage collects the overlapping pairs and is built in bulk
+  const bool sparse = distMatrix.isSparse();
+  std::vector<AdjacencyList::EdgeBuffer> overlaps(sparse ? nWorkers : 0);
+  // kNN mode offers every edge to bounded heaps of both its rows instead
+  std::vector<std::vector<std::vector<Scored>>> nearestHeaps(knn > 0 ? nWorkers : 0);
+  
+  // edges only come from pairs reaching the cutoff, and sparse or on-demand
+  // storage need no other score written here, so pairs whose set sizes alone
+  // rule them out (SizeBound) are never scored; sparse reads rescore them
+  // (with shared intersection counts the rows walk their partners instead)
+  const bool byPartners = counts && (sparse || distMatrix.isOnDemand());
+  sizeBound = SizeBound();
+  if (prune && (sparse || distMatrix.isOnDemand()) && !byPartners) {
+    sizeBound = SizeBound(geneSets, dm, edgeCutoff,
+                          [this](double score) { return distMatrix.quantize(score); });
+    if (sizeBound.candidateShare() >= 1.0)
+      sizeBound = SizeBound();
+    else if (verbose)
+      Rcpp::Rcout << "Set sizes rule out " << 100 * (1 - sizeBound.candidateShare())
+                  << "% of the pairs." << std::endl;
+  }
+  distMatrix.setUnscored(sparse && !sizeBound.empty()
+    ? std::function<bool(int, int)>([this](int t1, int t2) { return !sizeBound.mayPass(t1, t2); })
+    : nullptr);
+  
+  // only the overlap count touches the gene sets, the metric itself is O(1)
+  auto scorePair = [&](int i, int j, int common, int worker) {
+    double distanceScore = dm.computeDistance(common, geneSets.size(i), geneSets.size(j));
+    double stored;
+    if (sparse) {
+      stored = distMatrix.quantize(distanceScore);
+      if (common > 0)
+        overlaps[worker].push_back({i, j, stored});
+    } else {
+      stored = distMatrix.setDistance(distanceScore, i, j);
+      distMatrix.setDistance(distanceScore, j, i);
+    }
+    maxError[worker] = std::max(maxError[worker], std::fabs(stored - distanceScore));
     
-    for (int j=0; j<n_terms; ++j) {
-      if (i == j) {
-        distMatrix.setDistance(richCluster::SAME_TERM_DISTANCE, i, j);
-        continue;
+    // if term similarity is ABOVE the threshold
+    if (stored < edgeCutoff)
+      return;
+    if (knn > 0) {
+      std::vector<std::vector<Scored>>& heaps = nearestHeaps[worker];
+      if (heaps.empty()) heaps.resize(n_terms);
+      offerScored(heaps[i], knn, {stored, j});
+      offerScored(heaps[j], knn, {stored, i});
+    } else {
+      edges[worker].push_back({i, j, stored});
+    }
+  };
+  
+  for (int i=0; i<n_terms; ++i)
+    distMatrix.setDistance(richCluster::SAME_TERM_DISTANCE, i, i);
+  control->begin(RunControl::Phase::Scoring, uint64_t(n_terms) * (n_terms - 1) / 2);
+  distMatrix.beginFill();
+  if (byPartners || !sizeBound.empty()) {
+    // nothing is written per tile: every row meets its candidates only
+    parallelFor(nBlocks, nWorkers, [&](int block, int worker) {
+      control->checkpoint(worker == 0);
+      uint64_t pairs = 0;
+      for (int i=block * B; i<std::min((block + 1) * B, n_terms); ++i) {
+        pairs += n_terms - 1 - i;
+        if (byPartners) {
+          for (const int* p=std::upper_bound(counts->rowBegin(i), counts->rowEnd(i), i);
+               p!=counts->rowEnd(i); ++p)
+            scorePair(i, *p, counts->countAt(p), worker);
+        } else {
+          sizeBound.forCandidates(i, [&](int j) {
+            if (j > i) scorePair(i, j, geneSets.intersectionSize(i, j), worker);
+          });
+        }
       }
-      // unordered set of term2 genes
-      std::unordered_set<std::string> term2_genes = StringUtils::splitStringToUnorderedSet(geneIDs[j], ",");
-      
-      double distanceScore = dm.computeDistance(term1_genes, term2_genes, totalGeneCount);
-      distMatrix.setDistance(distanceScore, i, j);
-      
-      // if term similarity is ABOVE the threshold
-      if (distanceScore >= dm.getCutoff()) {
-        // add to adjacency list bidirectionally
-        adjList.addNeighbor(i, j);
-        adjList.addNeighbor(j, i);
+      control->advance(pairs);
+    });
+  } else {
+    parallelFor(nBlocks, nWorkers, [&](int block, int worker) {
+      const int bi = block * B;
+      for (int bj=bi; bj<n_terms; bj+=B) {
+        control->checkpoint(worker == 0);
+        uint64_t pairs = 0;
+        for (int i=bi; i<std::min(bi+B, n_terms); ++i) {
+          const int from = std::max(bj, i+1), to = std::min(bj+B, n_terms);
+          pairs += std::max(0, to - from);
+          if (counts) {
+            // every pair is written; the partners of i are read alongside
+            const int* p = std::lower_bound(counts->rowBegin(i), counts->rowEnd(i), from);
+            for (int j=from; j<to; ++j) {
+              const bool shared = p != counts->rowEnd(i) && *p == j;
+              scorePair(i, j, shared ? counts->countAt(p++) : 0, worker);
+            }
+          } else {
+            for (int j=from; j<to; ++j)
+              scorePair(i, j, geneSets.intersectionSize(i, j), worker);
+          }
+        }
+        control->advance(pairs);
       }
+    });
+  }
+  distMatrix.endFill();
+  
+  for (double e : maxError)
+    maxObservedError = std::max(maxObservedError, e);
+  if (sparse)
+    distMatrix.fillSparse(overlaps);
+  if (knn > 0)
+    buildNearestGraph(nearestHeaps);
+  else
+    adjList.build(n_terms, edges);
+  if (verbose)
+    Rcpp::Rcout << "Done filling out DistanceMatrix." << std::endl;
+}
+
+void richCluster::buildNearestGraph(std::vector<std::vector<std::vector<Scored>>>& heaps) {
+  std::vector<std::vector<Scored>> best(n_terms);
+  for (std::vector<std::vector<Scored>>& workerHeaps : heaps) {
+    for (int i=0; i<int(workerHeaps.size()); ++i) {
+      for (const Scored& candidate : workerHeaps[i])
+        offerScored(best[i], knn, candidate);
+      std::vector<Scored>().swap(workerHeaps[i]); // free as we go
     }
   }
-  Rcpp::Rcout << "Done filling out DistanceMatrix." << std::endl;
+  
+  nearestOffsets.assign(size_t(n_terms) + 1, 0);
+  nearest.clear();
+  for (int i=0; i<n_terms; ++i) {
+    std::sort(best[i].begin(), best[i].end(),
+              [](const Scored& x, const Scored& y) { return x.second < y.second; });
+    for (const Scored& pick : best[i])
+      nearest.push_back(pick.second);
+    nearestOffsets[i + 1] = nearest.size();
+  }
+  
+  std::vector<AdjacencyList::EdgeBuffer> edges(1);
+  for (int i=0; i<n_terms; ++i) {
+    for (const Scored& pick : best[i]) {
+      int j = pick.second;
+      if (!mutualKnn)
+        edges[0].push_back({i, j, pick.first});
+      else if (i < j && std::binary_search(nearest.begin() + nearestOffsets[j],
+                                           nearest.begin() + nearestOffsets[j + 1], i))
+        edges[0].push_back({i, j, pick.first});
+    }
+  }
+  adjList.build(n_terms, edges);
+  // mutual picks are the graph itself, and its degrees are <= knn already
+  if (mutualKnn) {
+    nearestOffsets.clear();
+    nearest.clear();
+  }
+  if (verbose)
+    Rcpp::Rcout << "Kept the " << knn << (mutualKnn ? " mutual" : "") << " nearest neighbours: "
+                << adjList.n_edges() << " edges." << std::endl;
+}
+
+// assemble the DistanceMatrix from precomputed shards instead of scoring pairs
+void richCluster::loadDistances(const std::vector<std::string>& shardFiles) {
+  if (verbose)
+    Rcpp::Rcout << "Loading " << shardFiles.size() << " distance shards..." << std::endl;
+  uint64_t fp = DistanceShard::fingerprint(geneIDs, dm.getName());
+  // shards hold input terms; duplicates land on the same row pair again
+  const int n_inputs = int(inputTerms.size());
+  std::vector<bool> rowLoaded(n_inputs, false);
+  std::vector<AdjacencyList::EdgeBuffer> edges(1);
+  std::vector<AdjacencyList::EdgeBuffer> overlaps(1);
+  std::vector<std::vector<std::vector<Scored>>> nearestHeaps(knn > 0 ? 1 : 0);
+  if (knn > 0) nearestHeaps[0].resize(n_terms);
+  
+  control->begin(RunControl::Phase::Loading, shardFiles.size());
+  for (const std::string& path : shardFiles) {
+    control->checkpoint(true);
+    std::pair<int, int> rows = DistanceShard::read(path, n_inputs, fp, [&](int t1, int t2, double distanceScore) {
+      int i = rowOf[t1], j = rowOf[t2];
+      if (i == j) return;
+      double stored;
+      if (distMatrix.isSparse()) {
+        stored = distMatrix.quantize(distanceScore);
+        if (stored != 0.0) // shards hold scores only; 0 is what sparse storage reads back anyway
+          overlaps[0].push_back({i, j, stored});
+      } else {
+        stored = distMatrix.setDistance(distanceScore, i, j);
+        distMatrix.setDistance(distanceScore, j, i);
+      }
+      maxObservedError = std::max(maxObservedError, std::fabs(stored - distanceScore));
+      if (stored < edgeCutoff)
+        return;
+      if (knn > 0) {
+        // duplicate terms repeat a row pair; a repeat is either still in the
+        // heap or was pushed out by better ones, so it never enters twice
+        for (const Scored& pick : {Scored(stored, j), Scored(stored, i)}) {
+          std::vector<Scored>& heap = nearestHeaps[0][pick.second == j ? i : j];
+          if (std::find(heap.begin(), heap.end(), pick) == heap.end())
+            offerScored(heap, knn, pick);
+        }
+      } else {
+        edges[0].push_back({i, j, stored});
+      }
+    });
+    for (int i = rows.first; i < rows.second; ++i)
+      rowLoaded[i] = true;
+    control->advance(1);
+  }
+  for (int t=0; t<n_inputs; ++t) {
+    if (!rowLoaded[t])
+      throw std::runtime_error("distance shards do not cover term " + std::to_string(t));
+  }
+  for (int i=0; i<n_terms; ++i)
+    distMatrix.setDistance(richCluster::SAME_TERM_DISTANCE, i, i);
+  if (distMatrix.isSparse())
+    distMatrix.fillSparse(overlaps);
+  if (knn > 0)
+    buildNearestGraph(nearestHeaps);
+  else
+    adjList.build(n_terms, edges);
+  if (verbose)
+    Rcpp::Rcout << "Done filling out DistanceMatrix." << std::endl;
+}
+
+// storage precision and the rounding error it introduced
+Rcpp::List richCluster::export_quantization() const {
+  return Rcpp::List::create(
+    Rcpp::_["precision"]          = distMatrix.getPrecision(),
+    Rcpp::_["max_error_bound"]    = distMatrix.maxQuantizationError(),
+    Rcpp::_["max_error_observed"] = maxObservedError,
+    Rcpp::_["distance_cutoff"]    = edgeCutoff,
+    Rcpp::_["linkage_cutoff"]     = lm.getCutoff()
+  );
 }
 
 // go through adjacency list and find the best subset of each seed
 void richCluster::filterSeeds() {
-  Rcpp::Rcout << "Filtering seeds..." << std::endl;
+  if (verbose)
+    Rcpp::Rcout << "Filtering seeds..." << std::endl;
   
-  for (const auto& [node, neighbors] : richCluster::adjList.getAdjList()) {
-    std::unordered_set<int> neighbors_set{neighbors};
-    std::unordered_set<int> cluster = filterSeed(node, neighbors_set);
-    clusList.addCluster(cluster);
+  seeds.assign(n_terms, std::unordered_set<int>());
+  control->begin(RunControl::Phase::Seeding, n_terms);
+  for (int node=0; node<n_terms; ++node) {
+    control->checkpoint(true);
+    seeds[node] = SeedClustering::filterSeed(node, seedNeighbors(node), lm);
+    clusList.addCluster(seeds[node]);
+    control->advance(1);
   }
-  Rcpp::Rcout << "Done filtering." << std::endl;
+  if (verbose)
+    Rcpp::Rcout << "Done filtering." << std::endl;
 }
 
-std::unordered_set<int> richCluster::filterSeed(
-    int node, std::unordered_set<int> neighbors
-) {
-  std::unordered_set<int> cluster{node};
-  while (true) {
-    int bestN = -1;
-    double bestLink = -1.0;
+void richCluster::mergeClusters() {
+  if (verbose)
+    Rcpp::Rcout << "Starting cluster merging..." << std::endl;
+  // the number of passes is unknown up front
+  control->begin(RunControl::Phase::Merging, 0);
+  SeedClustering::mergeClusters(clusList.getList(), lm, verbose,
+                                [this] { control->checkpoint(true); });
+  clusList.deduplicate();
+}
+
+// Terms in different connected components of the edge graph can only end up
+// in one cluster if some linkage of their (all below edgeCutoff) cross pairs
+// exceeds the linkage cutoff. Single, complete and average linkage never
+// exceed the largest cross pair, so with linkage cutoff >= edgeCutoff every
+// component is an independent subproblem: seeds and merges are run per
+// component on local indices and stitched back in seed order, which gives
+// the same clusters as filterSeeds() + mergeClusters() on the whole graph.
+void richCluster::clusterComponents() {
+  std::vector<int> rows(n_terms);
+  for (int i=0; i<n_terms; ++i) rows[i] = i;
+  seeds.assign(n_terms, std::unordered_set<int>());
+  for (auto& item : clusterRows(rows, true, &seeds, true))
+    clusList.addCluster(std::move(item.second));
+  clusList.deduplicate();
+  if (verbose)
+    Rcpp::Rcout << "Done clustering components." << std::endl;
+}
+
+std::vector<std::pair<int, std::unordered_set<int>>> richCluster::clusterRows(
+    const std::vector<int>& rows, bool byComponent,
+    std::vector<std::unordered_set<int>>* seedsOut, bool report) const {
+  const int m = int(rows.size());
+  std::vector<int> localOf(n_terms, -1);
+  for (int a=0; a<m; ++a) localOf[rows[a]] = a;
+  std::vector<std::vector<int>> components;
+  std::vector<std::pair<int, std::unordered_set<int>>> stitched; // (seed row, cluster)
+  if (!byComponent) {
+    if (m > 0) components.push_back(rows);
+  } else {
     
-    for (int n : neighbors) {
-      if (cluster.count(n)) continue;
-      std::unordered_set<int> n_set{n};
-      
-      try {
-        double link = lm.computeLinkage(cluster, n_set);
-        if (link > bestLink) {
-          bestLink = link;
-          bestN = n;
-        } 
-      } catch (const std::exception& e) {
-        Rcpp::Rcerr << "  EXCEPTION during linkage: " << e.what() << std::endl;
-        throw; // rethrow to bubble up
-      } 
+    // union-find over the edges among the rows
+    std::vector<int> parent(m);
+    for (int a=0; a<m; ++a) parent[a] = a;
+    auto find = [&parent](int x) {
+      while (parent[x] != x) {
+        parent[x] = parent[parent[x]]; // path halving
+        x = parent[x];
+      }
+      return x;
+    };
+    std::vector<bool> linked(m, false);
+    for (int a=0; a<m; ++a) {
+      for (int v : adjList.getNeighbors(rows[a])) {
+        int b = localOf[v];
+        if (b < 0) continue;
+        linked[a] = true;
+        if (b < a) continue;
+        int ra = find(a), rb = find(b);
+        if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+      }
     }
-    if (bestLink < lm.getCutoff() || bestN == -1)
-      break;
-    cluster.insert(bestN);
+    
+    // rows of every component, in order; isolated rows are their own cluster
+    std::vector<int> componentOf(m, -1);
+    for (int a=0; a<m; ++a) {
+      if (!linked[a]) {
+        if (seedsOut) (*seedsOut)[rows[a]] = {rows[a]};
+        stitched.emplace_back(rows[a], std::unordered_set<int>{rows[a]});
+        continue;
+      }
+      int root = find(a);
+      if (componentOf[root] < 0) {
+        componentOf[root] = int(components.size());
+        components.emplace_back();
+      }
+      components[componentOf[root]].push_back(rows[a]);
+    }
+  }
+  
+  // biggest components first so the threads finish together
+  std::vector<int> order(components.size());
+  for (size_t c=0; c<order.size(); ++c) order[c] = int(c);
+  std::sort(order.begin(), order.end(), [&components](int a, int b) {
+    return components[a].size() > components[b].size();
+  });
+  if (report && verbose)
+    Rcpp::Rcout << "Clustering " << components.size() << " connected components (largest: "
+                << (components.empty() ? 0 : components[order[0]].size()) << " terms, "
+                << stitched.size() << " isolated terms)..." << std::endl;
+  
+  // progress counts the terms of finished components
+  if (report) {
+    control->begin(RunControl::Phase::Clustering, m);
+    control->advance(stitched.size());
   }
-  return cluster;
+  std::vector<std::vector<std::pair<int, std::unordered_set<int>>>> results(components.size());
+  parallelFor(int(order.size()), threads, [&](int task, int worker) {
+    int c = order[task];
+    clusterComponent(components[c], results[c], worker == 0, seedsOut);
+    if (report)
+      control->advance(components[c].size());
+  });
+  
+  for (auto& result : results)
+    for (auto& item : result)
+      stitched.push_back(std::move(item));
+  std::sort(stitched.begin(), stitched.end(),
+            [&localOf](const std::pair<int, std::unordered_set<int>>& a,
+                       const std::pair<int, std::unordered_set<int>>& b) {
+              return localOf[a.first] < localOf[b.first];
+            });
+  return stitched;
 }
 
+// seeds + merges of one component (or any set of rows, in the order given);
+// runs on a worker thread, so no R API here
+void richCluster::clusterComponent(const std::vector<int>& nodes,
+                                   std::vector<std::pair<int, std::unordered_set<int>>>& out,
+                                   bool mainThread,
+                                   std::vector<std::unordered_set<int>>* seedsOut) const {
+  const int m = int(nodes.size());
+  std::vector<std::pair<int, int>> sorted(m); // (node, local index)
+  for (int a=0; a<m; ++a) sorted[a] = {nodes[a], a};
+  std::sort(sorted.begin(), sorted.end());
+  auto localIndex = [&sorted](int node) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(node, -1));
+    return (it != sorted.end() && it->first == node) ? it->second : -1;
+  };
+  
+  // compact local copy of the scores when it is small enough
+  std::vector<double> block;
+  std::function<double(int, int)> localDist;
+  if (m <= LOCAL_BLOCK_TERMS) {
+    block.resize(size_t(m) * m);
+    for (int a=0; a<m; ++a)
+      for (int b=0; b<m; ++b)
+        block[size_t(a) * m + b] = distMatrix.getDistance(nodes[a], nodes[b]);
+    localDist = [&block, m](int a, int b) { return block[size_t(a) * m + b]; };
+  } else {
+    localDist = [this, &nodes](int a, int b) { return distMatrix.getDistance(nodes[a], nodes[b]); };
+  }
+  
+  // component-local CSR rows, ascending as seeds break ties by neighbor order;
+  // neighbors outside nodes (left out of a subset) are dropped
+  std::vector<size_t> offsets(m + 1, 0);
+  std::vector<int> neighbors;
+  for (int a=0; a<m; ++a) {
+    for (int v : seedNeighbors(nodes[a])) {
+      int b = localIndex(v);
+      if (b >= 0) neighbors.push_back(b);
+    }
+    std::sort(neighbors.begin() + offsets[a], neighbors.end());
+    offsets[a + 1] = neighbors.size();
+  }
+  
+  auto toGlobal = [&nodes](const std::unordered_set<int>& cluster) {
+    std::unordered_set<int> global;
+    for (int a : cluster) global.insert(nodes[a]);
+    return global;
+  };
+  std::vector<std::unordered_set<int>> localSeeds(m);
+  auto clusters = SeedClustering::cluster(offsets, neighbors, localDist,
+                                          lm.getMethod(), lm.getCutoff(), &localSeeds,
+                                          [this, mainThread] { control->checkpoint(mainThread); });
+  if (seedsOut)
+    for (int a=0; a<m; ++a)
+      (*seedsOut)[nodes[a]] = toGlobal(localSeeds[a]);
+  for (const auto& [seed, cluster] : clusters)
+    out.emplace_back(nodes[seed], toGlobal(cluster));
+}
 
-void richCluster::mergeClusters() {
-  Rcpp::Rcout << "Starting cluster merging..." << std::endl;
 
-  bool mergingPossible = true;
-  int iteration = 0;
 
-  while (mergingPossible) {
-    iteration++;
-    Rcpp::Rcout << "Merge iteration " << iteration << "..." << std::endl;
-    int nMerged = 0;
-    auto& clusters = clusList.getList();
-    
-    for (auto it1 = clusters.begin(); it1 != clusters.end(); ++it1) {
-      auto it2 = findBestMergePartner(it1, clusters);
+richCluster::richCluster(std::vector<std::string> terms, GeneSetList geneSets,
+                         std::string distanceMetric, double distanceCutoff,
+                         std::string linkageMethod, double linkageCutoff,
+                         const DistanceStorageSpec& storage,
+                         std::vector<std::string> geneIDs,
+                         std::vector<int> rowOf):
+  inputTerms(std::move(terms)),
+  rowOf(std::move(rowOf)),
+  collapseDuplicates(!this->rowOf.empty()),
+  terms(rowNames(inputTerms, this->rowOf, geneSets.n_terms())),
+  rowTerms(this->terms.size()),
+  geneIDs(std::move(geneIDs)),
+  n_terms(int(this->terms.size())),
+  geneSets(std::move(geneSets)),
+  distMatrix(n_terms, this->terms, storage, DistanceMetric::scoreRange(distanceMetric)),
+  adjList(n_terms),
+  clusList(this->terms),
+  dm(DistanceMetric(distanceMetric, distanceCutoff)),
+  lm(LinkageMethod(linkageMethod, distMatrix.quantize(linkageCutoff), this->distFct()))
+{
+  for (int t=0; t<int(inputTerms.size()); ++t)
+    rowTerms[this->rowOf[t]].push_back(t);
+  if (distMatrix.isOnDemand() || distMatrix.isSparse()) {
+    distMatrix.setScorer([this](int t1, int t2) {
+      int common = counts ? counts->count(t1, t2) : this->geneSets.intersectionSize(t1, t2);
+      return distMatrix.quantize(dm.computeDistance(common, this->geneSets.size(t1),
+                                                    this->geneSets.size(t2)));
+    });
+  }
+  dm.setTotalGeneCount(this->geneSets.universeSize());
+  edgeCutoff = distMatrix.quantize(dm.getCutoff());
+  indexTerms(0);
+}
+
+// the first input term of every row; an empty rowOf becomes one row per term
+std::vector<std::string> richCluster::rowNames(const std::vector<std::string>& inputTerms,
+                                               std::vector<int>& rowOf, size_t rows) {
+  if (rowOf.empty()) {
+    if (inputTerms.size() != rows)
+      throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+    rowOf.resize(rows);
+    for (size_t t=0; t<rows; ++t) rowOf[t] = int(t);
+  }
+  if (rowOf.size() != inputTerms.size())
+    throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+  std::vector<std::string> names(rows);
+  std::vector<bool> named(rows, false);
+  for (size_t t=0; t<inputTerms.size(); ++t) {
+    if (rowOf[t] < 0 || size_t(rowOf[t]) >= rows)
+      throw std::invalid_argument("term mapped to a missing gene set");
+    if (!named[rowOf[t]]) {
+      names[rowOf[t]] = inputTerms[t];
+      named[rowOf[t]] = true;
+    }
+  }
+  return names;
+}
+
+std::unique_ptr<richCluster> richCluster::create(Rcpp::CharacterVector terms,
+                                                 Rcpp::CharacterVector geneIDs,
+                                                 std::string distanceMetric, double distanceCutoff,
+                                                 std::string linkageMethod, double linkageCutoff,
+                                                 const Rcpp::List& options) {
+  if (terms.size() != geneIDs.size())
+    throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+  std::vector<std::string> geneStrings = Rcpp::as<std::vector<std::string>>(geneIDs);
+  GeneSetList geneSets(geneStrings);
+  std::vector<int> rowOf;
+  if (options.containsElementNamed("collapse_duplicates")
+        && Rcpp::as<bool>(options["collapse_duplicates"])) {
+    rowOf = geneSets.collapseDuplicates();
+    if (geneSets.n_terms() < rowOf.size())
+      Rcpp::Rcout << "Collapsed " << rowOf.size() << " terms to " << geneSets.n_terms()
+                  << " distinct gene sets." << std::endl;
+  }
+  DistanceStorageSpec storage = storageSpec(options);
+  if (storage.backend == "auto") {
+    ResourcePlanner planner(geneSets, distanceMetric, distanceCutoff,
+                            ResourcePlanner::settings(options));
+    storage = planner.choose("auto");
+    Rcpp::Rcout << planner.summary() << std::endl;
+    for (const std::string& note : planner.getNotes())
+      Rcpp::Rcout << "Note: " << note << std::endl;
+  }
+  return std::unique_ptr<richCluster>(new richCluster(
+    Rcpp::as<std::vector<std::string>>(terms), std::move(geneSets),
+    distanceMetric, distanceCutoff, linkageMethod, linkageCutoff,
+    storage, std::move(geneStrings), std::move(rowOf)));
+}
+
+richCluster::RunSettings richCluster::runSettings(const Rcpp::List& options) {
+  RunSettings settings;
+  if (options.containsElementNamed("threads"))
+    settings.threads = Rcpp::as<int>(options["threads"]);
+  if (options.containsElementNamed("shard_files"))
+    settings.shardFiles = Rcpp::as<std::vector<std::string>>(options["shard_files"]);
+  if (options.containsElementNamed("cluster"))
+    settings.cluster = Rcpp::as<bool>(options["cluster"]);
+  if (options.containsElementNamed("components"))
+    settings.components = Rcpp::as<bool>(options["components"]);
+  if (options.containsElementNamed("knn"))
+    settings.knn = Rcpp::as<int>(options["knn"]);
+  if (options.containsElementNamed("mutual_knn"))
+    settings.mutualKnn = Rcpp::as<bool>(options["mutual_knn"]);
+  if (options.containsElementNamed("prune"))
+    settings.prune = Rcpp::as<bool>(options["prune"]);
+  return settings;
+}
+
+void richCluster::run(const Rcpp::List& options) {
+  RunSettings settings = runSettings(options);
+  control->setInterruptCheck([] { Rcpp::checkUserInterrupt(); });
+  try {
+    run(settings);
+  } catch (...) {
+    control->setInterruptCheck(nullptr);
+    throw;
+  }
+  control->setInterruptCheck(nullptr);
+}
+
+void richCluster::run(const RunSettings& settings) {
+  threads = settings.threads;
+  verbose = settings.verbose;
+  knn = std::max(0, settings.knn);
+  mutualKnn = settings.mutualKnn;
+  prune = settings.prune;
+  if (!settings.shardFiles.empty())
+    loadDistances(settings.shardFiles);
+  else
+    computeDistances();
+  if (!settings.cluster) {
+    control->finish(RunControl::Phase::Done);
+    return;
+  }
+  
+  if (settings.components && (knn > 0 || lm.getCutoff() >= edgeCutoff)) {
+    clusterComponents();
+  } else {
+    if (settings.components && verbose)
+      Rcpp::Rcout << "Linkage cutoff below distance cutoff, clustering the whole graph..." << std::endl;
+    filterSeeds();
+    mergeClusters();
+  }
+  control->finish(RunControl::Phase::Done);
+}
+
+void richCluster::releaseDistances() {
+  distMatrix.release();
+  adjList = AdjacencyList();
+  std::vector<size_t>().swap(nearestOffsets);
+  std::vector<int>().swap(nearest);
+  seeds.clear();
+  seeds.shrink_to_fit();
+}
+
+void richCluster::requireScores() const {
+  if (distMatrix.isReleased())
+    throw std::logic_error("the scores of this session were released, only its clusters can be exported");
+}
+
+Rcpp::List richCluster::addTerms(const std::vector<std::string>& newTerms,
+                                 const std::vector<std::string>& newGeneIDs) {
+  if (newTerms.size() != newGeneIDs.size())
+    throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+  // checked before anything grows, so a refused call leaves the session as it was
+  if (distMatrix.isSparse())
+    throw std::invalid_argument("sparse distance storage cannot add terms, use 'memory', 'mmap' or 'ondemand'");
+  if (distMatrix.isReleased())
+    throw std::logic_error("the scores of this result were released, so terms cannot be added");
+  Rcpp::Rcout << "Adding " << newTerms.size() << " terms..." << std::endl;
+  
+  const int oldN = n_terms;
+  const int oldInputs = int(inputTerms.size());
+  const int oldUniverse = geneSets.universeSize();
+  counts.reset(); // they cover the old sets only
+  inputTerms.insert(inputTerms.end(), newTerms.begin(), newTerms.end());
+  geneIDs.insert(geneIDs.end(), newGeneIDs.begin(), newGeneIDs.end());
+  geneSets.append(newGeneIDs);
+  indexTerms(oldInputs);
+  
+  // a term repeating a known gene set joins its row; only new sets get rows
+  std::vector<int> newRows;
+  if (collapseDuplicates) {
+    newRows = geneSets.collapseDuplicates(oldN);
+  } else {
+    for (int k=0; k<int(newTerms.size()); ++k) newRows.push_back(oldN + k);
+  }
+  n_terms = int(geneSets.n_terms());
+  rowTerms.resize(n_terms);
+  std::vector<std::string> newRowNames;
+  for (size_t k=0; k<newRows.size(); ++k) {
+    rowOf.push_back(newRows[k]);
+    rowTerms[newRows[k]].push_back(oldInputs + int(k));
+    if (newRows[k] >= oldN && rowTerms[newRows[k]].size() == 1)
+      newRowNames.push_back(newTerms[k]);
+  }
+  terms.insert(terms.end(), newRowNames.begin(), newRowNames.end());
+  distMatrix.appendTerms(newRowNames);
+  clusList.appendTerms(newRowNames);
+  dm.setTotalGeneCount(geneSets.universeSize());
+  
+  // new genes change N, and with it every kappa/hypergeometric score; a new
+  // term may also push older picks out of a kNN graph
+  bool universeGrew = dm.dependsOnTotalGeneCount() && geneSets.universeSize() != oldUniverse;
+  if (universeGrew || knn > 0) {
+    Rcpp::Rcout << (universeGrew ? "Gene universe grew" : "kNN graph")
+                << ", rescoring all pairs..." << std::endl;
+    adjList = AdjacencyList(n_terms);
+    clusList.getList().clear();
+    computeDistances();
+    filterSeeds();
+    mergeClusters();
+    return Rcpp::List::create(
+      Rcpp::_["new_terms"]            = int(newTerms.size()),
+      Rcpp::_["scored_pairs"]         = double(n_terms) * (n_terms - 1),
+      Rcpp::_["affected_terms"]       = n_terms,
+      Rcpp::_["kept_clusters"]        = 0,
+      Rcpp::_["reclustered_clusters"] = int(clusList.size()),
+      Rcpp::_["rescored_all"]         = true
+    );
+  }
+  
+  // score only the new rows (and their mirrored columns)
+  if (!sizeBound.empty())
+    sizeBound = SizeBound(geneSets, dm, edgeCutoff,
+                          [this](double score) { return distMatrix.quantize(score); });
+  std::set<int> affected;
+  std::vector<AdjacencyList::EdgeBuffer> edges(1);
+  double scoredPairs = 0;
+  for (int i=oldN; i<n_terms; ++i) {
+    affected.insert(i);
+    distMatrix.setDistance(richCluster::SAME_TERM_DISTANCE, i, i);
+    for (int j=0; j<i; ++j) {
+      if (!sizeBound.empty() && !sizeBound.mayPass(i, j))
+        continue; // on-demand storage, nothing to write
+      int common = geneSets.intersectionSize(i, j);
+      double distanceScore = dm.computeDistance(common, geneSets.size(i), geneSets.size(j));
+      double stored = distMatrix.setDistance(distanceScore, i, j);
+      distMatrix.setDistance(distanceScore, j, i);
+      maxObservedError = std::max(maxObservedError, std::fabs(stored - distanceScore));
+      scoredPairs += 2;
       
-      if (it2 != clusters.end() && it2 != it1) {
-        // Merge cluster2 into cluster1
-        it1->insert(it2->begin(), it2->end());
-        clusters.erase(it2);  // immediately erase
-        nMerged++;
+      if (stored >= edgeCutoff) {
+        edges[0].push_back({i, j, stored});
+        affected.insert(j); // j gained a neighbor
       }
-    } 
-    Rcpp::Rcout << "  Number of merges in this iteration: " << nMerged << std::endl;
-    if (nMerged == 0) {
-      Rcpp::Rcout << "No more merges possible. Merging complete." << std::endl;
-      break;
-    } 
+    }
   }
-  clusList.deduplicate();
+  adjList.addEdges(n_terms, edges);
+  
+  // a session created with cluster = FALSE has no seeds or clusters to keep,
+  // so every term is clustered, not only the affected ones
+  if (seeds.size() != size_t(oldN)) {
+    clusList.getList().clear();
+    filterSeeds();
+    mergeClusters();
+    return Rcpp::List::create(
+      Rcpp::_["new_terms"]            = int(newTerms.size()),
+      Rcpp::_["scored_pairs"]         = scoredPairs,
+      Rcpp::_["affected_terms"]       = n_terms,
+      Rcpp::_["kept_clusters"]        = 0,
+      Rcpp::_["reclustered_clusters"] = int(clusList.size()),
+      Rcpp::_["rescored_all"]         = false
+    );
+  }
+  
+  // only seeds whose neighborhood changed need filtering again
+  seeds.resize(n_terms);
+  for (int node : affected)
+    seeds[node] = SeedClustering::filterSeed(node, seedNeighbors(node), lm);
+  
+  // dissolve the clusters touching an affected term back into seeds, keep the rest
+  std::set<int> reseed(affected);
+  std::list<std::unordered_set<int>>& clusters = clusList.getList();
+  std::vector<bool> dissolved;
+  int keptClusters = 0, dissolvedClusters = 0;
+  for (const auto& cluster : clusters) {
+    bool touched = false;
+    for (int t : cluster) {
+      if (affected.count(t)) { touched = true; break; }
+    }
+    dissolved.push_back(touched);
+    if (touched) {
+      dissolvedClusters++;
+      reseed.insert(cluster.begin(), cluster.end());
+    } else {
+      keptClusters++;
+    }
+  }
+  
+  // Kept clusters could not merge with each other before, and single, complete
+  // and average linkage never exceed the largest cross pair, so with linkage
+  // cutoff >= edgeCutoff only a kept cluster sharing a term or an edge with a
+  // reseeded term can link to the new seeds (or to anything grown from them).
+  // The merges run over those and the seeds; the other kept clusters stay as they are.
+  std::vector<bool> near(n_terms, lm.getCutoff() < edgeCutoff);
+  for (int t : reseed) {
+    near[t] = true;
+    for (int v : adjList.getNeighbors(t)) near[v] = true;
+  }
+  std::list<std::unordered_set<int>> untouched, pool;
+  size_t c = 0;
+  for (auto it = clusters.begin(); it != clusters.end(); ++c) {
+    auto next = std::next(it);
+    if (!dissolved[c]) {
+      bool linked = false;
+      for (int t : *it) {
+        if (near[t]) { linked = true; break; }
+      }
+      if (linked)
+        pool.splice(pool.end(), clusters, it);
+      else
+        untouched.splice(untouched.end(), clusters, it);
+    }
+    it = next;
+  }
+  for (int t : reseed)
+    pool.push_back(seeds[t]);
+  clusters.swap(pool);
+  mergeClusters();
+  clusters.splice(clusters.begin(), untouched);
+  
+  return Rcpp::List::create(
+    Rcpp::_["new_terms"]            = int(newTerms.size()),
+    Rcpp::_["scored_pairs"]         = scoredPairs,
+    Rcpp::_["affected_terms"]       = int(affected.size()),
+    Rcpp::_["kept_clusters"]        = keptClusters,
+    Rcpp::_["reclustered_clusters"] = dissolvedClusters,
+    Rcpp::_["rescored_all"]         = false
+  );
+}
+
+double richCluster::termScore(int t1, int t2) const {
+  if (t1 == t2)
+    return SAME_TERM_DISTANCE;
+  int r1 = rowOf[t1], r2 = rowOf[t2];
+  if (r1 != r2)
+    return distMatrix.getDistance(r1, r2);
+  int size = geneSets.size(r1);
+  return distMatrix.quantize(dm.computeDistance(size, size, size));
+}
+
+Rcpp::NumericMatrix richCluster::termMatrix(const std::vector<int>& inputs) const {
+  const int n = int(inputs.size());
+  std::vector<int> rows(n);
+  Rcpp::CharacterVector names(n);
+  for (int a=0; a<n; ++a) {
+    rows[a] = rowOf[inputs[a]];
+    names[a] = inputTerms[inputs[a]];
+  }
+  Rcpp::NumericMatrix scores = distMatrix.export_r(rows);
+  if (collapsed()) {
+    for (int a=0; a<n; ++a)
+      for (int b=0; b<n; ++b)
+        if (rows[a] == rows[b] && inputs[a] != inputs[b])
+          scores(a, b) = termScore(inputs[a], inputs[b]);
+  }
+  scores.attr("dimnames") = Rcpp::List::create(names, names);
+  return scores;
+}
+
+Rcpp::NumericMatrix richCluster::export_dm() const {
+  if (!collapsed())
+    return distMatrix.export_r();
+  std::vector<int> inputs(inputTerms.size());
+  for (size_t t=0; t<inputs.size(); ++t) inputs[t] = int(t);
+  return termMatrix(inputs);
+}
+
+Rcpp::DataFrame richCluster::export_cl() const {
+  if (!collapsed())
+    return clusList.export_r();
+  ClusterList expanded(inputTerms);
+  for (const auto& cluster : clusList.getList()) {
+    std::unordered_set<int> members;
+    for (int row : cluster)
+      members.insert(rowTerms[row].begin(), rowTerms[row].end());
+    expanded.addCluster(std::move(members));
+  }
+  return expanded.export_r();
+}
+
+Rcpp::List richCluster::export_result(bool exportDistances) const {
+  if (exportDistances)
+    requireScores();
+  return Rcpp::List::create(
+    Rcpp::_["distance_matrix"] = exportDistances ? Rcpp::RObject(export_dm()) : Rcpp::RObject(R_NilValue),
+    Rcpp::_["all_clusters"]    = export_cl(),
+    Rcpp::_["quantization"]    = export_quantization()
+  );
+}
+
+Rcpp::List richCluster::export_subset(const std::vector<int>& inputs, bool exportDistances) const {
+  requireScores();
+  const int n_inputs = int(inputTerms.size());
+  std::vector<bool> picked(n_inputs, false);
+  std::vector<std::vector<int>> positions(n_terms); // of every row in inputs
+  std::vector<int> rows;
+  std::vector<std::string> names(inputs.size());
+  for (size_t p=0; p<inputs.size(); ++p) {
+    const int t = inputs[p];
+    if (t < 0 || t >= n_inputs)
+      throw std::out_of_range("subset index " + std::to_string(t) + " is not a term");
+    if (picked[t])
+      throw std::invalid_argument("subset term " + inputTerms[t] + " is given twice");
+    picked[t] = true;
+    names[p] = inputTerms[t];
+    if (positions[rowOf[t]].empty())
+      rows.push_back(rowOf[t]);
+    positions[rowOf[t]].push_back(int(p));
+  }
+  
+  // the same choice as run() with its default options
+  const bool byComponent = knn > 0 || lm.getCutoff() >= edgeCutoff;
+  ClusterList clusters(names);
+  for (auto& item : clusterRows(rows, byComponent, nullptr, false)) {
+    std::unordered_set<int> members;
+    for (int row : item.second)
+      members.insert(positions[row].begin(), positions[row].end());
+    clusters.addCluster(std::move(members));
+  }
+  clusters.deduplicate();
+  return Rcpp::List::create(
+    Rcpp::_["distance_matrix"] = exportDistances ? Rcpp::RObject(termMatrix(inputs)) : Rcpp::RObject(R_NilValue),
+    Rcpp::_["all_clusters"]    = clusters.export_r(),
+    Rcpp::_["quantization"]    = export_quantization()
+  );
+}
+
+void richCluster::indexTerms(int from) {
+  for (int t=from; t<int(inputTerms.size()); ++t)
+    termIndex.emplace(inputTerms[t], t);
+}
+
+std::vector<int> richCluster::lookupTerms(const std::vector<std::string>& names) const {
+  std::vector<int> indices;
+  indices.reserve(names.size());
+  for (const std::string& name : names) {
+    auto it = termIndex.find(name);
+    if (it == termIndex.end())
+      throw std::invalid_argument("unknown term: " + name);
+    indices.push_back(it->second);
+  }
+  return indices;
+}
+
+Rcpp::NumericMatrix richCluster::export_submatrix(const std::vector<std::string>& names) const {
+  requireScores();
+  return termMatrix(lookupTerms(names));
+}
+
+Rcpp::DataFrame richCluster::export_neighbours(const std::string& term, int k) const {
+  requireScores();
+  int t = lookupTerms({term})[0];
+  std::vector<std::pair<double, int>> scored;
+  scored.reserve(inputTerms.size());
+  for (int j=0; j<int(inputTerms.size()); ++j) {
+    if (j != t)
+      scored.emplace_back(termScore(t, j), j);
+  }
+  // highest score first, ties by row so the order is stable
+  k = std::max(0, std::min(k, int(scored.size())));
+  std::partial_sort(scored.begin(), scored.begin() + k, scored.end(),
+                    [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+                      return a.first > b.first || (a.first == b.first && a.second < b.second);
+                    });
+  Rcpp::CharacterVector neighbours(k);
+  Rcpp::NumericVector scores(k);
+  for (int i=0; i<k; ++i) {
+    neighbours[i] = inputTerms[scored[i].second];
+    scores[i] = scored[i].first;
+  }
+  return Rcpp::DataFrame::create(
+    Rcpp::_["Term"] = neighbours,
+    Rcpp::_["Score"] = scores,
+    Rcpp::_["stringsAsFactors"] = false
+  );
+}
+
+// edges among nodes scoring >= minScore, each pair listed once as (a, b) with
+// a < b positions in nodes; topK > 0 keeps only the k best edges of every node
+// (an edge stays if it is among the top k of either end)
+void richCluster::collectEdges(const std::vector<int>& nodes, double minScore, int topK,
+                               std::vector<int>& from, std::vector<int>& to,
+                               std::vector<double>& weight) const {
+  const int m = int(nodes.size());
+  std::vector<int> position(inputTerms.size(), -1);
+  for (int a=0; a<m; ++a)
+    if (position[nodes[a]] < 0) position[nodes[a]] = a;
+  
+  // every pair passing the cutoff already is an adjacency edge, so only
+  // thresholds below it need the score storage itself (a kNN graph has
+  // dropped some of them)
+  const bool fromAdjacency = knn == 0 && minScore >= edgeCutoff;
+  auto forCandidates = [&](int a, auto&& fn) {
+    if (fromAdjacency) {
+      // the input terms of the neighboring rows, and the term's own duplicates
+      const int row = rowOf[nodes[a]];
+      for (int j : adjList.getNeighbors(row))
+        for (int t : rowTerms[j])
+          if (position[t] >= 0) fn(position[t]);
+      for (int t : rowTerms[row])
+        if (t != nodes[a] && position[t] >= 0) fn(position[t]);
+    } else {
+      for (int b=0; b<m; ++b)
+        if (b != a && nodes[b] != nodes[a]) fn(b);
+    }
+  };
+  
+  std::vector<std::pair<int, int>> pairs;
+  if (topK <= 0) {
+    for (int a=0; a<m; ++a) {
+      forCandidates(a, [&](int b) {
+        if (a < b && termScore(nodes[a], nodes[b]) >= minScore)
+          pairs.emplace_back(a, b);
+      });
+    }
+  } else {
+    // bounded heap of the k best per node
+    std::vector<Scored> heap;
+    for (int a=0; a<m; ++a) {
+      heap.clear();
+      forCandidates(a, [&](int b) {
+        double score = termScore(nodes[a], nodes[b]);
+        if (score >= minScore)
+          offerScored(heap, topK, {score, b});
+      });
+      for (const Scored& kept : heap)
+        pairs.emplace_back(std::min(a, kept.second), std::max(a, kept.second));
+    }
+  }
+  
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+  from.reserve(pairs.size());
+  to.reserve(pairs.size());
+  weight.reserve(pairs.size());
+  for (const auto& [a, b] : pairs) {
+    from.push_back(a);
+    to.push_back(b);
+    weight.push_back(termScore(nodes[a], nodes[b]));
+  }
+}
+
+Rcpp::List richCluster::export_edges(const std::vector<std::string>& names,
+                                     double minScore, int topK) const {
+  requireScores();
+  std::vector<int> nodes;
+  if (names.empty()) {
+    nodes.resize(inputTerms.size());
+    for (size_t t=0; t<nodes.size(); ++t) nodes[t] = int(t);
+  } else {
+    nodes = lookupTerms(names);
+  }
+  std::vector<int> from, to;
+  std::vector<double> weight;
+  collectEdges(nodes, minScore, topK, from, to, weight);
+  
+  Rcpp::CharacterVector nodeNames(nodes.size());
+  for (size_t a=0; a<nodes.size(); ++a)
+    nodeNames[a] = inputTerms[nodes[a]];
+  return Rcpp::List::create(
+    Rcpp::_["nodes"]  = nodeNames,
+    Rcpp::_["source"] = Rcpp::IntegerVector(from.begin(), from.end()),
+    Rcpp::_["target"] = Rcpp::IntegerVector(to.begin(), to.end()),
+    Rcpp::_["weight"] = Rcpp::NumericVector(weight.begin(), weight.end())
+  );
 }
 
-ClusterList::ClusterIt richCluster::findBestMergePartner(
-    ClusterList::ClusterIt it1, std::list<std::unordered_set<int>>& clusters
-) {
-  double bestLink = -1.0;
-  auto bestIt = clusters.end();
-   
-  for (auto it2 = clusters.begin(); it2 != clusters.end(); ++it2) {
-    if (it1 == it2) continue;
-     
-    double link = lm.computeLinkage(*it1, *it2);
-    if (link > bestLink && link > lm.getCutoff()) {
-      bestLink = link;
-      bestIt = it2;
-    } 
+Rcpp::List richCluster::export_dendrogram(const std::string& linkageMethod, bool overSeeds) const {
+  requireScores();
+  double top = DistanceMetric::scoreRange(dm.getName()).second;
+  if (!std::isfinite(top)) {
+    top = -std::numeric_limits<double>::infinity();
+    for (int i=0; i<n_terms; ++i) {
+      if (rowTerms[i].size() > 1)
+        top = std::max(top, termScore(rowTerms[i][0], rowTerms[i][1]));
+      for (int j=i+1; j<n_terms; ++j)
+        top = std::max(top, distMatrix.getDistance(i, j));
+    }
+  }
+  
+  if (!overSeeds) {
+    Dendrogram tree(int(inputTerms.size()), [this, top](int a, int b) {
+      return top - termScore(a, b);
+    }, linkageMethod);
+    Rcpp::List result = tree.export_r(inputTerms);
+    result["score_top"] = top;
+    return result;
+  }
+  
+  // distinct seeds in node order (a session rebuilt for queries has none yet)
+  LinkageMethod seedLinkage(lm);
+  std::vector<std::vector<int>> leaves;
+  std::vector<std::string> labels;
+  std::set<std::vector<int>> seen;
+  for (int node=0; node<n_terms; ++node) {
+    std::unordered_set<int> seed = int(seeds.size()) == n_terms ? seeds[node]
+      : SeedClustering::filterSeed(node, seedNeighbors(node), seedLinkage);
+    std::vector<int> members;
+    for (int row : seed)
+      members.insert(members.end(), rowTerms[row].begin(), rowTerms[row].end());
+    std::sort(members.begin(), members.end());
+    if (seen.insert(members).second) {
+      leaves.push_back(std::move(members));
+      labels.push_back(terms[node]);
+    }
   }
   
-  return bestIt;
-} 
+  // seed dissimilarity: the linkage of their terms
+  Dendrogram tree(int(leaves.size()), [&](int a, int b) {
+    double sum = 0.0, least = std::numeric_limits<double>::infinity(), most = -least;
+    int pairs = 0;
+    for (int i : leaves[a]) {
+      for (int j : leaves[b]) {
+        if (i == j) continue;
+        double d = top - termScore(i, j);
+        sum += d;
+        least = std::min(least, d);
+        most = std::max(most, d);
+        pairs++;
+      }
+    }
+    if (pairs == 0) return 0.0;
+    if (linkageMethod == "single") return least;
+    if (linkageMethod == "complete") return most;
+    return sum / pairs;
+  }, linkageMethod);
+  Rcpp::List result = tree.export_r(labels);
+  Rcpp::List members(leaves.size());
+  for (size_t a=0; a<leaves.size(); ++a)
+    members[a] = Rcpp::IntegerVector(leaves[a].begin(), leaves[a].end());
+  result["score_top"] = top;
+  result["seeds"] = members;
+  return result;
+}
+
+Rcpp::DataFrame richCluster::export_summary(const std::vector<std::string>& names,
+                                            const std::vector<std::vector<int>>& clusters,
+                                            const std::vector<std::string>& valueNames,
+                                            const std::vector<std::vector<double>>& values,
+                                            int threads) const {
+  requireScores();
+  const std::vector<int> inputs = lookupTerms(names);
+  for (const auto& column : values)
+    if (column.size() != names.size())
+      throw std::invalid_argument("every value column needs one value per term");
+  std::vector<std::vector<int>> positions(n_terms); // of every row in names
+  for (size_t p=0; p<inputs.size(); ++p)
+    positions[rowOf[inputs[p]]].push_back(int(p));
+  
+  ClusterSummary summary(int(names.size()), clusters, [&](int a, int b) {
+    return termScore(inputs[a], inputs[b]);
+  }, [&](int a, const std::function<void(int)>& fn) {
+    // duplicates of a's gene set, then the terms of its edges
+    const int row = rowOf[inputs[a]];
+    for (int p : positions[row])
+      if (p != a) fn(p);
+    for (int neighbor : adjList.getNeighbors(row))
+      for (int p : positions[neighbor]) fn(p);
+  }, threads);
+  summary.aggregate(valueNames, values, threads);
+  return summary.export_r(names);
+}
+
+DistanceStorageSpec richCluster::storageSpec(const Rcpp::List& options) {
+  DistanceStorageSpec storage;
+  if (options.containsElementNamed("storage"))
+    storage.backend = Rcpp::as<std::string>(options["storage"]);
+  if (options.containsElementNamed("storage_path"))
+    storage.path = Rcpp::as<std::string>(options["storage_path"]);
+  if (options.containsElementNamed("precision"))
+    storage.precision = Rcpp::as<std::string>(options["precision"]);
+  return storage;
+}
 
 
 
 // the exported function to R
 // [[Rcpp::export]]
-Rcpp::List runRichCluster(Rcpp::CharacterVector terms,
-                          Rcpp::CharacterVector geneIDs,
-                          std::string distanceMetric, double distanceCutoff,
-                          std::string linkageMethod, double linkageCutoff) {
+SEXP runRichCluster(Rcpp::CharacterVector terms,
+                    Rcpp::CharacterVector geneIDs,
+                    std::string distanceMetric, double distanceCutoff,
+                    std::string linkageMethod, double linkageCutoff,
+                    Rcpp::List options = Rcpp::List::create()) {
   Rcpp::Rcout << "Starting richCluster..." << std::endl;
   Rcpp::Rcout << "terms.size = " << terms.size() << std::endl;
   Rcpp::Rcout << "geneIDs.size = " << geneIDs.size() << std::endl;
   try {
-    richCluster RC(terms, geneIDs,
-                   distanceMetric, distanceCutoff,
-                   linkageMethod, linkageCutoff);
-    RC.computeDistances();
-    RC.filterSeeds();
-    RC.mergeClusters();
+    bool exportDistances = !options.containsElementNamed("export_distances")
+      || Rcpp::as<bool>(options["export_distances"]);
     
-    return Rcpp::List::create(
-      Rcpp::_["distance_matrix"] = RC.export_dm(),
-      Rcpp::_["all_clusters"]    = RC.export_cl()
-    ); 
+    if (options.containsElementNamed("plan_only") && Rcpp::as<bool>(options["plan_only"]))
+      return ResourcePlanner::plan(Rcpp::as<std::vector<std::string>>(geneIDs),
+                                   distanceMetric, distanceCutoff, options);
+    
+    std::unique_ptr<richCluster> RC = richCluster::create(terms, geneIDs,
+                                                          distanceMetric, distanceCutoff,
+                                                          linkageMethod, linkageCutoff,
+                                                          options);
+    if (options.containsElementNamed("async") && Rcpp::as<bool>(options["async"]))
+      return ClusterJob::start(std::move(RC), options);
+    RC->run(options);
+    return RC->export_result(exportDistances);
+  } catch (Rcpp::internal::InterruptedException&) {
+    throw; // R handles the interrupt
   } catch (const std::exception& e) {
     Rcpp::stop("C++ exception: %s", e.what());
   } catch (...) { 
@@ -15,40 +15,102 @@
 #include <vector>
 #include <string>
 #include <functional>
+#include <memory>
 
 #include "DistanceMatrix.h"
 #include "AdjacencyList.h"
 #include "ClusterList.h"
 #include "DistanceMetric.h"
 #include "LinkageMethod.h"
+#include "GeneSetList.h"
+#include "SeedClustering.h"
+#include "Dendrogram.h"
+#include "RunControl.h"
+#include "SizeBound.h"
+#include "IntersectionCounts.h"
+#include "ClusterSummary.h"
 
 
 class richCluster {
 public:
-  richCluster(Rcpp::CharacterVector r_terms,
-              Rcpp::CharacterVector r_geneIDs,
+  // from gene sets parsed (or interned) elsewhere; needs no R API, so it can be
+  // built on a worker thread. Loading shards needs the geneIDs strings.
+  // rowOf maps every term to its set after GeneSetList::collapseDuplicates()
+  // (empty: one set per term, and terms added later are not collapsed)
+  richCluster(std::vector<std::string> terms, GeneSetList geneSets,
               std::string distanceMetric, double distanceCutoff,
-              std::string linkageMethod, double linkageCutoff):
-  // convert R --> C++
-  terms(Rcpp::as<std::vector<std::string>>(r_terms)),
-  geneIDs(Rcpp::as<std::vector<std::string>>(r_geneIDs)),
-  n_terms(int(terms.size())),
-  
-  // initialize data structures
-  distMatrix(n_terms, terms),
-  adjList(n_terms),
-  clusList(terms),
-  
-  // initialize metrics
-  dm(DistanceMetric(distanceMetric, distanceCutoff)),
-  lm(LinkageMethod(linkageMethod, linkageCutoff, this->distFct()))
-  { // checks: ensure vectors are of same size
-    if (terms.size() != geneIDs.size())
-      throw std::invalid_argument("input vectors (terms, geneIDs) must be the same size");
+              std::string linkageMethod, double linkageCutoff,
+              const DistanceStorageSpec& storage = DistanceStorageSpec(),
+              std::vector<std::string> geneIDs = {},
+              std::vector<int> rowOf = {});
+  // parses the inputs once, collapses duplicate gene sets (when
+  // options$collapse_duplicates = TRUE) and resolves options$storage = "auto"
+  // with a ResourcePlanner (printing its plan) before any scores are allocated
+  static std::unique_ptr<richCluster> create(Rcpp::CharacterVector terms,
+                                             Rcpp::CharacterVector geneIDs,
+                                             std::string distanceMetric, double distanceCutoff,
+                                             std::string linkageMethod, double linkageCutoff,
+                                             const Rcpp::List& options);
+  
+  // the engine options of run(), read from the R options list by runSettings()
+  struct RunSettings {
+    int threads = 1;                     // <= 0 uses every hardware thread
+    std::vector<std::string> shardFiles; // load distances instead of computing them
+    bool cluster = true;                 // false stops after the scores
+    bool components = true;              // false forces the whole-graph path
+    bool verbose = true;                 // false: no Rcout, as on worker threads
+    int knn = 0;                         // > 0: keep each term's knn best edges only
+    bool mutualKnn = false;              // kNN edges need both ends to pick each other
+    bool prune = true;                   // skip pairs their set sizes rule out (see SizeBound)
   };
+  static RunSettings runSettings(const Rcpp::List& options);
+  
+  // scores every pair; edges are the pairs scoring >= the distance cutoff or,
+  // with knn > 0, only the knn best of those for every term (see buildNearestGraph).
+  // Sparse and on-demand storage skip the pairs whose set sizes cannot reach
+  // the cutoff (unless prune is off)
   void computeDistances();
+  void loadDistances(const std::vector<std::string>& shardFiles); // from DistanceShard files
   void filterSeeds(); // informally denoting (node, neighbors) =: seed
   void mergeClusters();
+  // filterSeeds + mergeClusters per connected component of the edge graph, in
+  // parallel; only exact when the linkage cutoff is >= the distance cutoff
+  // (in kNN mode clusters are kept within components by design)
+  void clusterComponents();
+  // computeDistances (or loadDistances from options$shard_files), then
+  // clusterComponents (or filterSeeds, mergeClusters if that is not exact or
+  // options$components = FALSE); options$cluster = FALSE stops after the
+  // scores (enough for the queries below). options$knn / options$mutual_knn
+  // select the kNN graph. The R options overload runs on the main thread and
+  // also stops on user interrupts.
+  void run(const Rcpp::List& options);
+  void run(const RunSettings& settings);
+  
+  // progress of run() and its cooperative cancellation (checked between
+  // tiles, seeds and components); a run on another thread shares it with
+  // the main thread, which polls it
+  std::shared_ptr<RunControl> runControl() const { return control; };
+  void setRunControl(std::shared_ptr<RunControl> shared) { control = std::move(shared); };
+  
+  // |A n B| of every pair counted beforehand over the same gene sets (eg.
+  // shared by the runs of several metrics): computeDistances() and on-demand
+  // reads take them from there instead of intersecting; addTerms drops them
+  void setIntersectionCounts(std::shared_ptr<const IntersectionCounts> shared) {
+    counts = std::move(shared);
+  };
+  
+  // drops the scores and adjacency once only clusters and quantization are
+  // exported (export_result(false)); queries and addTerms are invalid afterwards
+  void releaseDistances();
+  
+  int n_genes() const { return geneSets.universeSize(); };
+  size_t n_edges() const { return adjList.n_edges(); };
+  size_t n_clusters() const { return clusList.size(); };
+  
+  // score the new terms against everything and only re-cluster the affected
+  // neighborhoods; clusters not touching a new edge are kept as they are
+  Rcpp::List addTerms(const std::vector<std::string>& newTerms,
+                      const std::vector<std::string>& newGeneIDs);
   
   static constexpr double SAME_TERM_DISTANCE = -99;
   
@@ -58,29 +120,119 @@ public:
       return distMatrix.getDistance(t1, t2);
     }; }
   
-  Rcpp::NumericMatrix export_dm() const {return distMatrix.export_r();};
-  Rcpp::DataFrame export_cl() const {return clusList.export_r();};
+  // per input term, duplicates expanded back
+  Rcpp::NumericMatrix export_dm() const;
+  Rcpp::DataFrame export_cl() const;
+  Rcpp::List export_quantization() const;
+  Rcpp::List export_result(bool exportDistances = true) const;
+  // clusters of the given input terms only, over the scores and edges already
+  // computed for every term, so nothing is rescored; the same as clustering
+  // them alone in that order (but with the gene universe of every term). As
+  // export_result() with term indices being positions in inputs
+  Rcpp::List export_subset(const std::vector<int>& inputs, bool exportDistances = true) const;
+  
+  // queries straight from the stored scores, so plots never need the full matrix
+  Rcpp::NumericMatrix export_submatrix(const std::vector<std::string>& names) const;
+  Rcpp::DataFrame export_neighbours(const std::string& term, int k) const; // top k by score
+  // edges with score >= minScore (and at most the topK best per node when topK > 0)
+  // among names (all terms if empty); source/target are 0-based positions in nodes
+  Rcpp::List export_edges(const std::vector<std::string>& names, double minScore, int topK = 0) const;
+  
+  // complete hclust-style tree (see Dendrogram) over the terms, or over the
+  // distinct filtered seeds, on dissimilarities top - score, top being the
+  // metric's maximum (the largest stored score if unbounded)
+  Rcpp::List export_dendrogram(const std::string& linkageMethod, bool overSeeds) const;
+  
+  // per-cluster medoid, cohesion and nearest cluster over the stored scores,
+  // plus aggregates of value columns (see ClusterSummary). clusters hold
+  // positions in names; values hold one column per valueNames entry, with
+  // one value per name
+  Rcpp::DataFrame export_summary(const std::vector<std::string>& names,
+                                 const std::vector<std::vector<int>>& clusters,
+                                 const std::vector<std::string>& valueNames,
+                                 const std::vector<std::vector<double>>& values,
+                                 int threads = 1) const;
+  
+  // storage/precision settings from an R options list
+  static DistanceStorageSpec storageSpec(const Rcpp::List& options);
   
   
 private:
-  std::unordered_set<int>  filterSeed(int node, std::unordered_set<int> neighbors);
-  ClusterList::ClusterIt findBestMergePartner(
-      ClusterList::ClusterIt it1, std::list<std::unordered_set<int>>& clusters
-  );
+  using Scored = std::pair<double, int>; // (score, neighbor)
+  // the knn best of every row over the bounded heaps of all threads; i-j is
+  // an edge if either row picked the other (both with mutualKnn). Without
+  // mutualKnn a hub picked by many rows keeps its degree, so seeds grow from
+  // each row's own picks (nearest) to stay O(knn) per seed.
+  void buildNearestGraph(std::vector<std::vector<std::vector<Scored>>>& heaps);
+  // queries call this first: after releaseDistances() there is nothing to read
+  void requireScores() const;
+  AdjacencyList::Span<int> seedNeighbors(int node) const {
+    if (nearestOffsets.empty())
+      return adjList.getNeighbors(node);
+    return {nearest.data() + nearestOffsets[node], nearest.data() + nearestOffsets[node + 1]};
+  };
+  void clusterComponent(const std::vector<int>& nodes,
+                        std::vector<std::pair<int, std::unordered_set<int>>>& out,
+                        bool mainThread,
+                        std::vector<std::unordered_set<int>>* seedsOut = nullptr) const;
+  // (seed row, cluster) of the given rows clustered on their own, in seed
+  // order: per connected component of the edges among them, or all at once
+  // (the greedy merges follow the order of rows); seedsOut gets their
+  // filtered seeds, report logs and updates the RunControl
+  std::vector<std::pair<int, std::unordered_set<int>>> clusterRows(
+      const std::vector<int>& rows, bool byComponent,
+      std::vector<std::unordered_set<int>>* seedsOut, bool report) const;
+  // components up to this size get a dense local copy of their scores
+  static constexpr int LOCAL_BLOCK_TERMS = 2048;
+  void collectEdges(const std::vector<int>& nodes, double minScore, int topK,
+                    std::vector<int>& from, std::vector<int>& to,
+                    std::vector<double>& weight) const;
+  void indexTerms(int from); // adds inputTerms[from..] to termIndex
+  std::vector<int> lookupTerms(const std::vector<std::string>& names) const; // input terms
+  
+  // scores of input terms: duplicates of one gene set share its row but still
+  // score against each other like any two identical sets would
+  bool collapsed() const { return n_terms < int(inputTerms.size()); };
+  double termScore(int t1, int t2) const;
+  Rcpp::NumericMatrix termMatrix(const std::vector<int>& inputs) const;
+  static std::vector<std::string> rowNames(const std::vector<std::string>& inputTerms,
+                                           std::vector<int>& rowOf, size_t rows);
   
   // essential variables
-  std::vector<std::string> terms;
-  std::vector<std::string> geneIDs;
-  int n_terms;
+  // terms with identical gene sets are scored and clustered once, as one row
+  // of the scores, adjacency, seeds and clusters; input term t is row
+  // rowOf[t], and rows are only expanded back to input terms on export
+  std::vector<std::string> inputTerms; // every term, in input order
+  std::vector<int> rowOf;
+  bool collapseDuplicates;
+  std::vector<std::string> terms; // per row: its first input term
+  std::vector<std::vector<int>> rowTerms; // per row: its input terms, ascending
+  std::vector<std::string> geneIDs; // per input term (for shard fingerprints)
+  int n_terms; // rows
+  GeneSetList geneSets; // interned gene sets, parsed once; one per row
+  std::unordered_map<std::string, int> termIndex; // first input term of every name
   
   // data structures
   DistanceMatrix distMatrix;
   AdjacencyList adjList;
+  std::vector<size_t> nearestOffsets; // kNN picks of every row, ascending
+  std::vector<int> nearest;           // (union kNN graph only)
   ClusterList clusList;
+  std::vector<std::unordered_set<int>> seeds; // filtered seed of every node
   
   // metrics
   DistanceMetric dm;
   LinkageMethod lm;
+  double edgeCutoff;
+  double maxObservedError = 0.0; // largest |stored - computed| score this run
+  int threads = 1; // options$threads; <= 0 uses every hardware thread
+  int knn = 0;
+  bool mutualKnn = false;
+  bool prune = true;
+  SizeBound sizeBound; // of the last computeDistances(); empty if not pruning
+  std::shared_ptr<const IntersectionCounts> counts; // optional, see setIntersectionCounts
+  bool verbose = true; // progress messages (main thread only)
+  std::shared_ptr<RunControl> control = std::make_shared<RunControl>();
 };
 
 #endif /* richCluster_h */
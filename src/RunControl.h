@@ -0,0 +1,97 @@
+//
+//  RunControl.h
+//  richCluster
+//
+
+#ifndef RunControl_h
+#define RunControl_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// thrown at the next checkpoint once a run was cancelled
+struct RunCancelled : std::runtime_error {
+  RunCancelled(): std::runtime_error("clustering was cancelled") {};
+};
+
+// Progress and cancellation of one richCluster run, shared between the
+// thread(s) doing the work and the R main thread polling it. Everything but
+// the interrupt check is lock-free and safe to call from any thread.
+class RunControl {
+public:
+  enum class Phase { Starting, Loading, Scoring, Seeding, Merging, Clustering,
+                     Done, Cancelled, Failed };
+
+  // a new phase of `total` units of work (0: unknown, fraction() is NaN)
+  void begin(Phase next, uint64_t total) {
+    totalUnits = total;
+    doneUnits = 0;
+    phaseCode = int(next);
+  };
+  void advance(uint64_t units) { doneUnits += units; };
+  void finish(Phase last) { phaseCode = int(last); };
+
+  Phase phase() const { return Phase(phaseCode.load()); };
+  uint64_t done() const { return doneUnits; };
+  uint64_t total() const { return totalUnits; };
+  double fraction() const {
+    const uint64_t all = totalUnits;
+    if (all == 0)
+      return std::numeric_limits<double>::quiet_NaN();
+    return std::min(1.0, double(doneUnits) / double(all));
+  };
+  static std::string phaseName(Phase p) {
+    switch (p) {
+      case Phase::Starting:   return "starting";
+      case Phase::Loading:    return "loading";
+      case Phase::Scoring:    return "scoring";
+      case Phase::Seeding:    return "seeding";
+      case Phase::Merging:    return "merging";
+      case Phase::Clustering: return "clustering";
+      case Phase::Done:       return "done";
+      case Phase::Cancelled:  return "cancelled";
+      case Phase::Failed:     return "failed";
+    }
+    return "unknown";
+  };
+
+  void cancel() { cancelled = true; };
+  bool isCancelled() const { return cancelled; };
+
+  // synchronous runs poll R for user interrupts (eg. Rcpp::checkUserInterrupt,
+  // which throws); the check only ever runs on the thread that called R
+  void setInterruptCheck(std::function<void()> check) { interruptCheck = std::move(check); };
+
+  // called between tiles / seeds / components: throws RunCancelled once
+  // cancel() was called and, on the main thread, checks for user interrupts
+  // at most every INTERRUPT_INTERVAL
+  void checkpoint(bool mainThread) {
+    if (cancelled)
+      throw RunCancelled();
+    if (!mainThread || !interruptCheck)
+      return;
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastInterruptCheck < INTERRUPT_INTERVAL)
+      return;
+    lastInterruptCheck = now;
+    interruptCheck();
+  };
+
+private:
+  static constexpr std::chrono::milliseconds INTERRUPT_INTERVAL{100};
+
+  std::atomic<int> phaseCode{int(Phase::Starting)};
+  std::atomic<uint64_t> doneUnits{0};
+  std::atomic<uint64_t> totalUnits{0};
+  std::atomic<bool> cancelled{false};
+  std::function<void()> interruptCheck;
+  std::chrono::steady_clock::time_point lastInterruptCheck; // main thread only
+};
+
+#endif /* RunControl_h */
@@ -0,0 +1,390 @@
+//
+//  ScoreSketch.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "ScoreSketch.h"
+#include "DistanceMetric.h"
+#include "Parallel.h"
+#include "ResourcePlanner.h"
+
+namespace {
+
+int findRoot(int* parent, int x) {
+  while (parent[x] != x) {
+    parent[x] = parent[parent[x]];
+    x = parent[x];
+  }
+  return x;
+}
+
+void unite(int* parent, int a, int b) {
+  int ra = findRoot(parent, a), rb = findRoot(parent, b);
+  if (ra != rb) parent[std::max(ra, rb)] = std::min(ra, rb);
+}
+
+double gigabytes(double bytes) { return bytes / (1024.0 * 1024.0 * 1024.0); }
+
+} // namespace
+
+ScoreSketch::ScoreSketch(const GeneSetList& geneSets, const std::string& distanceMetric,
+                         const std::vector<double>& cutoffs, const Settings& settings):
+  n_terms(int(geneSets.n_terms())), cutoffs(cutoffs) {
+  auto start = std::chrono::steady_clock::now();
+  for (double c : cutoffs)
+    if (!(c > 0))
+      throw std::invalid_argument("cutoffs must be positive");
+
+  DistanceMetric dm(distanceMetric, cutoffs.empty() ? 0.0 : cutoffs[0]);
+  dm.setTotalGeneCount(geneSets.universeSize());
+  const auto range = DistanceMetric::scoreRange(distanceMetric);
+  lower = range.first;
+  if (std::isfinite(range.second)) {
+    binWidth = (range.second - range.first) / BOUNDED_BINS;
+    histogram.assign(BOUNDED_BINS, 0);
+  } else {
+    binWidth = UNBOUNDED_BIN_WIDTH;
+    histogram.assign(UNBOUNDED_BINS, 0);
+  }
+
+  const int C = int(cutoffs.size());
+  edges.assign(C, 0);
+  largest.assign(C, n_terms > 0 ? 1 : 0);
+  if (n_terms < 2) {
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return;
+  }
+
+  // a uniform sample of terms, in index order for locality
+  sampled = std::max(1, std::min(n_terms, settings.sampleTerms));
+  exact = sampled == n_terms;
+  std::vector<int> rows(n_terms);
+  std::iota(rows.begin(), rows.end(), 0);
+  if (!exact) {
+    std::mt19937_64 rng(settings.seed);
+    for (int i=0; i<sampled; ++i) {
+      std::uniform_int_distribution<int> pick(i, n_terms - 1);
+      std::swap(rows[i], rows[pick(rng)]);
+    }
+    rows.resize(sampled);
+  }
+  const std::vector<int> seedOrder = rows; // random order, for the component walks
+  std::sort(rows.begin(), rows.end());
+
+  // gene -> terms containing it
+  const int nGenes = geneSets.universeSize();
+  std::vector<size_t> offsets(nGenes + 1, 0);
+  for (int t=0; t<n_terms; ++t)
+    for (int g : geneSets.genes(t)) ++offsets[g + 1];
+  for (int g=0; g<nGenes; ++g) offsets[g + 1] += offsets[g];
+  std::vector<int> postings(offsets[nGenes]);
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for (int t=0; t<n_terms; ++t)
+      for (int g : geneSets.genes(t)) postings[fill[g]++] = t;
+  }
+
+  struct Worker {
+    std::vector<int> common, touched;
+    std::vector<uint64_t> histogram;
+    std::vector<int> parent; // one union-find of all terms per cutoff (exact only)
+    double minScore = std::numeric_limits<double>::infinity();
+    double maxScore = -std::numeric_limits<double>::infinity();
+  };
+  const int threads = std::max(1, std::min(resolveThreads(settings.threads), sampled));
+  std::vector<Worker> workers(threads);
+  // fn(j, score) for every term j sharing a gene with r
+  auto forOverlaps = [&](int r, Worker& w, const auto& fn) {
+    if (w.common.empty())
+      w.common.assign(n_terms, 0);
+    for (int g : geneSets.genes(r)) {
+      for (size_t p=offsets[g]; p<offsets[g + 1]; ++p) {
+        const int j = postings[p];
+        if (j != r && w.common[j]++ == 0)
+          w.touched.push_back(j);
+      }
+    }
+    for (int j : w.touched) {
+      fn(j, dm.computeDistance(w.common[j], geneSets.size(r), geneSets.size(j)));
+      w.common[j] = 0;
+    }
+    w.touched.clear();
+  };
+
+  // neighbours scoring at least the smallest cutoff, kept for the component
+  // walks below (sampled terms first, others when a walk reaches them)
+  const double minCutoff = C ? *std::min_element(cutoffs.begin(), cutoffs.end()) : 0;
+  std::vector<std::vector<std::pair<int, double>>> neighbours(exact || !C ? 0 : n_terms);
+  std::vector<char> scored(neighbours.size(), 0);
+  std::vector<int> degree(size_t(sampled) * C, 0);
+  std::vector<int> overlaps(sampled, 0);
+
+  parallelFor(sampled, threads, [&](int task, int worker) {
+    Worker& w = workers[worker];
+    if (w.histogram.empty()) {
+      w.histogram.assign(histogram.size(), 0);
+      if (exact) {
+        w.parent.resize(size_t(C) * n_terms);
+        for (int c=0; c<C; ++c)
+          std::iota(w.parent.begin() + size_t(c) * n_terms,
+                    w.parent.begin() + size_t(c + 1) * n_terms, 0);
+      }
+    }
+    const int r = rows[task];
+    int* deg = degree.data() + size_t(task) * C;
+    forOverlaps(r, w, [&](int j, double score) {
+      ++overlaps[task];
+      ++w.histogram[binOf(score)];
+      w.minScore = std::min(w.minScore, score);
+      w.maxScore = std::max(w.maxScore, score);
+      if (!neighbours.empty() && score >= minCutoff)
+        neighbours[r].push_back({j, score});
+      for (int c=0; c<C; ++c) {
+        if (score < cutoffs[c]) continue;
+        ++deg[c];
+        if (exact && j > r)
+          unite(w.parent.data() + size_t(c) * n_terms, r, j);
+      }
+    });
+    if (!neighbours.empty())
+      scored[r] = 1;
+  });
+
+  minScore = std::numeric_limits<double>::infinity();
+  maxScore = -std::numeric_limits<double>::infinity();
+  for (const Worker& w : workers) {
+    if (w.histogram.empty()) continue;
+    for (size_t b=0; b<histogram.size(); ++b) histogram[b] += w.histogram[b];
+    minScore = std::min(minScore, w.minScore);
+    maxScore = std::max(maxScore, w.maxScore);
+  }
+  for (int o : overlaps) overlapPairs += o;
+  zeroPairs = double(sampled) * (n_terms - 1) - overlapPairs;
+
+  // every pair of the sampled terms was seen; over all terms each pair counts once
+  const double scale = double(n_terms) / sampled / 2;
+  for (int c=0; c<C; ++c) {
+    double degrees = 0;
+    for (int s=0; s<sampled; ++s)
+      degrees += degree[size_t(s) * C + c];
+    edges[c] = degrees * scale;
+  }
+
+  if (exact) {
+    for (int c=0; c<C; ++c) {
+      int* root = nullptr;
+      for (Worker& w : workers) {
+        if (w.parent.empty()) continue;
+        int* parent = w.parent.data() + size_t(c) * n_terms;
+        if (!root) { root = parent; continue; }
+        for (int t=0; t<n_terms; ++t)
+          unite(root, t, findRoot(parent, t));
+      }
+      std::vector<int> size(n_terms, 0);
+      int biggest = 0;
+      for (int t=0; t<n_terms; ++t)
+        biggest = std::max(biggest, ++size[findRoot(root, t)]);
+      largest[c] = biggest;
+    }
+  } else {
+    // walk the component of every sampled term (in random order) until it
+    // closes or reaches `cap` terms; components that close are measured
+    // exactly, the share of seeds in capped ones estimates the giant one
+    const int cap = std::max(50, settings.sampleTerms / 10);
+    const double budget = 2.0 * settings.sampleTerms; // terms scored per cutoff
+    for (int c=0; c<C; ++c) {
+      std::vector<int> component(n_terms, -1);
+      std::vector<char> capped;
+      int seeds = 0, seedsCapped = 0, biggest = 1, biggestCapped = 0;
+      double spent = 0;
+      for (int seed : seedOrder) {
+        if (component[seed] < 0) {
+          if (spent >= budget)
+            break;
+          const int id = int(capped.size());
+          bool reachedCap = false;
+          int size = 1;
+          component[seed] = id;
+          std::vector<int> frontier{seed}, next, missing;
+          while (!frontier.empty() && !reachedCap) {
+            missing.clear();
+            for (int u : frontier)
+              if (!scored[u]) missing.push_back(u);
+            parallelFor(int(missing.size()), threads, [&](int task, int worker) {
+              const int u = missing[task];
+              forOverlaps(u, workers[worker], [&](int j, double score) {
+                if (score >= minCutoff) neighbours[u].push_back({j, score});
+              });
+              scored[u] = 1;
+            });
+            spent += missing.size();
+            next.clear();
+            for (int u : frontier) {
+              for (const auto& [v, score] : neighbours[u]) {
+                if (score < cutoffs[c] || component[v] == id) continue;
+                if (component[v] >= 0 || ++size >= cap) { // joins a capped walk
+                  reachedCap = true;
+                  break;
+                }
+                component[v] = id;
+                next.push_back(v);
+              }
+              if (reachedCap) break;
+            }
+            frontier.swap(next);
+          }
+          capped.push_back(reachedCap);
+          if (reachedCap)
+            biggestCapped = std::max(biggestCapped, size);
+          else
+            biggest = std::max(biggest, size);
+        }
+        ++seeds;
+        seedsCapped += capped[component[seed]];
+      }
+      if (seedsCapped > 0)
+        largest[c] = std::max(double(biggest),
+                              std::max(double(biggestCapped), double(seedsCapped) / seeds * n_terms));
+      else
+        largest[c] = biggest;
+    }
+  }
+  seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int ScoreSketch::binOf(double score) const {
+  double b = std::floor((score - lower) / binWidth);
+  return int(std::max(0.0, std::min(b, double(histogram.size() - 1))));
+}
+
+double ScoreSketch::quantile(double p, bool overlapsOnly) const {
+  double total = overlapPairs + (overlapsOnly ? 0 : zeroPairs);
+  if (total <= 0)
+    return std::numeric_limits<double>::quiet_NaN();
+  double low = minScore, high = maxScore;
+  if (!overlapsOnly && zeroPairs > 0) {
+    low = std::min(low, 0.0);
+    high = std::max(high, 0.0);
+  }
+
+  const double target = std::max(0.0, std::min(1.0, p)) * total;
+  // the zeros go before the first bin starting at or above 0
+  const size_t zeroBin = size_t(std::max(0.0, std::ceil(-lower / binWidth)));
+  double seen = 0;
+  for (size_t b=0; b<histogram.size(); ++b) {
+    if (!overlapsOnly && b == zeroBin && zeroPairs > 0) {
+      if (target <= seen + zeroPairs)
+        return 0.0;
+      seen += zeroPairs;
+    }
+    const double mass = double(histogram[b]);
+    if (mass > 0 && target <= seen + mass) {
+      double score = lower + binWidth * (b + (target - seen) / mass);
+      return std::max(low, std::min(high, score));
+    }
+    seen += mass;
+  }
+  return high;
+}
+
+Rcpp::List ScoreSketch::export_r(const std::vector<double>& probabilities) const {
+  const int Q = int(probabilities.size()), C = int(cutoffs.size());
+  Rcpp::NumericVector all(Q), overlapping(Q);
+  for (int q=0; q<Q; ++q) {
+    double a = quantile(probabilities[q], false), o = quantile(probabilities[q], true);
+    all[q] = std::isnan(a) ? NA_REAL : a;
+    overlapping[q] = std::isnan(o) ? NA_REAL : o;
+  }
+
+  const double n = n_terms, pairs = n * (n - 1) / 2;
+  Rcpp::NumericVector edgeCount(C), density(C), meanDegree(C), component(C), memory(C);
+  for (int c=0; c<C; ++c) {
+    edgeCount[c] = edges[c];
+    density[c] = pairs > 0 ? edges[c] / pairs : 0;
+    meanDegree[c] = n > 0 ? 2 * edges[c] / n : 0;
+    component[c] = largest[c];
+    memory[c] = gigabytes(edges[c] * ResourcePlanner::BYTES_PER_EDGE);
+  }
+
+  const double overlapTotal = sampled ? overlapPairs * n / sampled / 2 : 0;
+  std::ostringstream summary;
+  summary.precision(3);
+  summary << "Sketch: " << n_terms << " gene sets, "
+          << (exact ? "all scored" : std::to_string(sampled) + " sampled") << ", "
+          << (pairs > 0 ? 100 * overlapTotal / pairs : 0) << "% of pairs share a gene ("
+          << seconds << " s)";
+
+  return Rcpp::List::create(
+    Rcpp::_["n_sets"]        = n_terms,
+    Rcpp::_["n_pairs"]       = pairs,
+    Rcpp::_["sampled_sets"]  = sampled,
+    Rcpp::_["exact"]         = exact,
+    Rcpp::_["overlap_pairs"] = overlapTotal,
+    Rcpp::_["quantiles"] = Rcpp::DataFrame::create(
+      Rcpp::_["Probability"]  = probabilities,
+      Rcpp::_["Score"]        = all,
+      Rcpp::_["OverlapScore"] = overlapping
+    ),
+    Rcpp::_["cutoffs"] = Rcpp::DataFrame::create(
+      Rcpp::_["Cutoff"]           = cutoffs,
+      Rcpp::_["Edges"]            = edgeCount,
+      Rcpp::_["EdgeDensity"]      = density,
+      Rcpp::_["MeanDegree"]       = meanDegree,
+      Rcpp::_["LargestComponent"] = component,
+      Rcpp::_["EdgeMemoryGB"]     = memory
+    ),
+    Rcpp::_["seconds"] = seconds,
+    Rcpp::_["summary"] = summary.str()
+  );
+}
+
+ScoreSketch::Settings ScoreSketch::settings(const Rcpp::List& options) {
+  Settings settings;
+  if (options.containsElementNamed("sample_terms"))
+    settings.sampleTerms = Rcpp::as<int>(options["sample_terms"]);
+  if (options.containsElementNamed("threads"))
+    settings.threads = Rcpp::as<int>(options["threads"]);
+  if (options.containsElementNamed("seed"))
+    settings.seed = uint64_t(Rcpp::as<double>(options["seed"]));
+  return settings;
+}
+
+Rcpp::List ScoreSketch::sketch(const std::vector<std::string>& geneIDs,
+                               const std::string& distanceMetric,
+                               const std::vector<double>& cutoffs,
+                               const std::vector<double>& probabilities,
+                               const Rcpp::List& options) {
+  GeneSetList geneSets(geneIDs);
+  // as richCluster::create(): identical gene sets are scored once
+  if (options.containsElementNamed("collapse_duplicates")
+        && Rcpp::as<bool>(options["collapse_duplicates"]))
+    geneSets.collapseDuplicates();
+  ScoreSketch sketch(geneSets, distanceMetric, cutoffs, settings(options));
+  return sketch.export_r(probabilities);
+}
+
+
+
+// the exported function to R: scores a sample of the terms, nothing is clustered
+// [[Rcpp::export]]
+Rcpp::List sketchScores(Rcpp::CharacterVector geneIDs, std::string distanceMetric,
+                        std::vector<double> cutoffs, std::vector<double> probabilities,
+                        Rcpp::List options = Rcpp::List::create()) {
+  try {
+    return ScoreSketch::sketch(Rcpp::as<std::vector<std::string>>(geneIDs), distanceMetric,
+                               cutoffs, probabilities, options);
+  } catch (const std::exception& e) {
+    Rcpp::stop("C++ exception: %s", e.what());
+  }
+}
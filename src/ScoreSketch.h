@@ -0,0 +1,70 @@
+//
+//  ScoreSketch.h
+//  richCluster
+//
+
+#ifndef ScoreSketch_h
+#define ScoreSketch_h
+
+#include <Rcpp.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GeneSetList.h"
+
+// Distribution of the pairwise scores, and of the graph each candidate
+// distance cutoff would give, without scoring every pair. Pairs that share
+// no gene score 0 under every metric, so only the overlaps of a term are
+// scored, found through a gene -> terms index. A uniform sample of terms
+// (every term if there are at most settings.sampleTerms) is scored against
+// all others:
+//   scores     histogram over the metric's range, plus the pairs at 0
+//   edges      n/2 * the mean degree of the sampled terms, per cutoff
+//   largest    component: exact (union-find) when every term was sampled,
+//              else the giant component of a random graph with the
+//              sampled degree distribution
+class ScoreSketch {
+public:
+  struct Settings {
+    int sampleTerms = 2000;
+    int threads = 1;
+    uint64_t seed = 1;
+  };
+
+  ScoreSketch(const GeneSetList& geneSets, const std::string& distanceMetric,
+              const std::vector<double>& cutoffs, const Settings& settings);
+
+  // the score below which a share p of all pairs (or of the pairs sharing
+  // a gene) falls, interpolated within histogram bins
+  double quantile(double p, bool overlapsOnly) const;
+  Rcpp::List export_r(const std::vector<double>& probabilities) const;
+
+  static Settings settings(const Rcpp::List& options);
+  static Rcpp::List sketch(const std::vector<std::string>& geneIDs,
+                           const std::string& distanceMetric,
+                           const std::vector<double>& cutoffs,
+                           const std::vector<double>& probabilities,
+                           const Rcpp::List& options);
+
+private:
+  static constexpr int BOUNDED_BINS = 1 << 14;
+  static constexpr int UNBOUNDED_BINS = 1 << 17;
+  static constexpr double UNBOUNDED_BIN_WIDTH = 0.01; // -log10 p-values up to ~1300
+
+  int n_terms = 0, sampled = 0;
+  bool exact = false;
+  std::vector<double> cutoffs;
+
+  double lower = 0, binWidth = 0;
+  std::vector<uint64_t> histogram;    // overlapping pairs of the sampled terms
+  double zeroPairs = 0, overlapPairs = 0; // among the sampled terms' pairs
+  double minScore = 0, maxScore = 0;      // of the overlapping pairs
+
+  std::vector<double> edges, largest; // per cutoff, estimated over all terms
+  double seconds = 0;
+
+  int binOf(double score) const;
+};
+
+#endif /* ScoreSketch_h */
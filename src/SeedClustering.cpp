@@ -0,0 +1,112 @@
+//
+//  SeedClustering.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <Rcpp.h>
+#include <unordered_map>
+#include "SeedClustering.h"
+
+SeedClustering::Cluster SeedClustering::filterSeed(
+    int node, AdjacencyList::Span<int> neighbors, LinkageMethod& lm
+) {
+  Cluster cluster{node};
+  while (true) {
+    int bestN = -1;
+    double bestLink = -1.0;
+    
+    for (int n : neighbors) {
+      if (cluster.count(n)) continue;
+      Cluster n_set{n};
+      
+      double link = lm.computeLinkage(cluster, n_set);
+      if (link > bestLink) {
+        bestLink = link;
+        bestN = n;
+      } 
+    }
+    if (bestLink < lm.getCutoff() || bestN == -1)
+      break;
+    cluster.insert(bestN);
+  }
+  return cluster;
+}
+
+void SeedClustering::mergeClusters(std::list<Cluster>& clusters, LinkageMethod& lm, bool verbose,
+                                   const std::function<void()>& checkpoint) {
+  int iteration = 0;
+
+  while (true) {
+    iteration++;
+    if (verbose)
+      Rcpp::Rcout << "Merge iteration " << iteration << "..." << std::endl;
+    int nMerged = 0;
+    
+    for (auto it1 = clusters.begin(); it1 != clusters.end(); ++it1) {
+      if (checkpoint) checkpoint();
+      auto it2 = findBestMergePartner(it1, clusters, lm);
+      
+      if (it2 != clusters.end() && it2 != it1) {
+        // Merge cluster2 into cluster1
+        it1->insert(it2->begin(), it2->end());
+        clusters.erase(it2);  // immediately erase
+        nMerged++;
+      }
+    } 
+    if (verbose)
+      Rcpp::Rcout << "  Number of merges in this iteration: " << nMerged << std::endl;
+    if (nMerged == 0) {
+      if (verbose)
+        Rcpp::Rcout << "No more merges possible. Merging complete." << std::endl;
+      break;
+    } 
+  }
+}
+
+SeedClustering::ClusterIt SeedClustering::findBestMergePartner(
+    ClusterIt it1, std::list<Cluster>& clusters, LinkageMethod& lm
+) {
+  double bestLink = -1.0;
+  auto bestIt = clusters.end();
+   
+  for (auto it2 = clusters.begin(); it2 != clusters.end(); ++it2) {
+    if (it1 == it2) continue;
+     
+    double link = lm.computeLinkage(*it1, *it2);
+    if (link > bestLink && link > lm.getCutoff()) {
+      bestLink = link;
+      bestIt = it2;
+    } 
+  }
+  
+  return bestIt;
+} 
+
+std::vector<std::pair<int, SeedClustering::Cluster>> SeedClustering::cluster(
+    const std::vector<size_t>& offsets, const std::vector<int>& neighbors,
+    std::function<double(int, int)> dist,
+    const std::string& linkageMethod, double linkageCutoff,
+    std::vector<Cluster>* seeds, const std::function<void()>& checkpoint) {
+  const int m = int(offsets.size()) - 1;
+  LinkageMethod lm(linkageMethod, linkageCutoff, dist);
+  
+  // list nodes stay put, so their addresses remember which seed they started as
+  std::list<Cluster> clusters;
+  std::unordered_map<const Cluster*, int> seedOf;
+  for (int a=0; a<m; ++a) {
+    if (checkpoint) checkpoint();
+    AdjacencyList::Span<int> row{neighbors.data() + offsets[a], neighbors.data() + offsets[a + 1]};
+    clusters.push_back(filterSeed(a, row, lm));
+    if (seeds)
+      (*seeds)[a] = clusters.back();
+    seedOf[&clusters.back()] = a;
+  }
+  mergeClusters(clusters, lm, false, checkpoint);
+  
+  std::vector<std::pair<int, Cluster>> out;
+  out.reserve(clusters.size());
+  for (auto& cluster : clusters)
+    out.emplace_back(seedOf.at(&cluster), std::move(cluster));
+  return out;
+}
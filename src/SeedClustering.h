@@ -0,0 +1,50 @@
+//
+//  SeedClustering.h
+//  richCluster
+//
+
+#ifndef SeedClustering_h
+#define SeedClustering_h
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "AdjacencyList.h"
+#include "LinkageMethod.h"
+
+// the seed filtering and greedy merge passes of richCluster, independent of
+// where the scores live, so components and resampling replicates can run
+// them on their own (local) indices
+class SeedClustering {
+public:
+  using Cluster = std::unordered_set<int>;
+  using ClusterIt = std::list<Cluster>::iterator;
+
+  // grow {node} by its best-linked neighbor while the linkage stays >= cutoff
+  static Cluster filterSeed(int node, AdjacencyList::Span<int> neighbors, LinkageMethod& lm);
+  // merge passes until one pass merges nothing; verbose (main thread only) logs every pass.
+  // checkpoint (if set) is called before every cluster looks for a partner
+  // and may throw to abandon the merge
+  static void mergeClusters(std::list<Cluster>& clusters, LinkageMethod& lm, bool verbose = false,
+                            const std::function<void()>& checkpoint = nullptr);
+  static ClusterIt findBestMergePartner(ClusterIt it1, std::list<Cluster>& clusters,
+                                        LinkageMethod& lm);
+
+  // seeds + merges of terms 0..m-1: the neighbors of a are
+  // neighbors[offsets[a] .. offsets[a+1]) and dist(a, b) their score.
+  // Returns every cluster with the node whose seed it grew from, in seed order;
+  // seeds (if given) gets every filtered seed; checkpoint as for mergeClusters,
+  // also called before every seed. No R API, so it runs on worker threads.
+  static std::vector<std::pair<int, Cluster>> cluster(
+      const std::vector<size_t>& offsets, const std::vector<int>& neighbors,
+      std::function<double(int, int)> dist,
+      const std::string& linkageMethod, double linkageCutoff,
+      std::vector<Cluster>* seeds = nullptr,
+      const std::function<void()>& checkpoint = nullptr);
+};
+
+#endif /* SeedClustering_h */
@@ -0,0 +1,54 @@
+//
+//  SizeBound.cpp
+//  richCluster
+//
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "SizeBound.h"
+
+SizeBound::SizeBound(const GeneSetList& geneSets, const DistanceMetric& dm, double cutoff,
+                     const std::function<double(double)>& quantize) {
+  const int n = int(geneSets.n_terms());
+  std::vector<int> sizes;
+  for (int t=0; t<n; ++t) sizes.push_back(geneSets.size(t));
+  std::sort(sizes.begin(), sizes.end());
+  sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+  const int S = int(sizes.size());
+
+  classOf.resize(n);
+  classStart.assign(S + 1, 0);
+  for (int t=0; t<n; ++t) {
+    classOf[t] = int(std::lower_bound(sizes.begin(), sizes.end(), geneSets.size(t)) - sizes.begin());
+    ++classStart[classOf[t] + 1];
+  }
+  for (int c=0; c<S; ++c) classStart[c + 1] += classStart[c];
+  bySize.resize(n);
+  std::vector<size_t> fill(classStart.begin(), classStart.end() - 1);
+  for (int t=0; t<n; ++t) bySize[fill[classOf[t]]++] = t;
+
+  // O(distinct sizes^2) bounds, each O(1) at an overlap of min(a, b)
+  double passing = 0;
+  runOffsets.assign(1, 0);
+  for (int a=0; a<S; ++a) {
+    int from = -1;
+    for (int b=0; b<=S; ++b) {
+      bool pass = b < S
+        && quantize(dm.computeDistance(std::min(sizes[a], sizes[b]), sizes[a], sizes[b])) >= cutoff;
+      if (pass && from < 0) {
+        from = b;
+      } else if (!pass && from >= 0) {
+        runs.push_back({from, b});
+        from = -1;
+      }
+      if (pass) {
+        const double na = double(classStart[a + 1] - classStart[a]);
+        const double nb = double(classStart[b + 1] - classStart[b]);
+        passing += a == b ? na * (na - 1) : na * nb; // ordered pairs
+      }
+    }
+    runOffsets.push_back(runs.size());
+  }
+  share = n > 1 ? passing / (double(n) * (n - 1)) : 1.0;
+}
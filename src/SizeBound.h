@@ -0,0 +1,58 @@
+//
+//  SizeBound.h
+//  richCluster
+//
+
+#ifndef SizeBound_h
+#define SizeBound_h
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "DistanceMetric.h"
+#include "GeneSetList.h"
+
+// Length filter of all-pairs set-similarity joins: every supported metric
+// grows with |A n B| <= min(|A|, |B|), so a pair of sets of sizes a and b
+// scores at most computeDistance(min(a, b), a, b), whatever genes they hold.
+// Terms are grouped by size; for every size the partner sizes whose bound
+// still reaches the cutoff are kept as runs of the sorted sizes (one run in
+// practice: a tiny term next to a hub term never passes), so candidates()
+// lists the only partners worth intersecting without looking at the others.
+class SizeBound {
+public:
+  SizeBound() = default;
+  // quantize rounds a score like the stored scores, cutoff is already rounded
+  SizeBound(const GeneSetList& geneSets, const DistanceMetric& dm, double cutoff,
+            const std::function<double(double)>& quantize);
+
+  bool empty() const { return classOf.empty(); };
+  // false: the pair scores below the cutoff for sure
+  bool mayPass(int t1, int t2) const {
+    const int c1 = classOf[t1], c2 = classOf[t2];
+    for (size_t r=runOffsets[c1]; r<runOffsets[c1 + 1]; ++r)
+      if (c2 >= runs[r].first && c2 < runs[r].second) return true;
+    return false;
+  };
+  // fn(j) for every term j (including t itself) that mayPass with t
+  template <class Fn>
+  void forCandidates(int t, Fn fn) const {
+    const int c = classOf[t];
+    for (size_t r=runOffsets[c]; r<runOffsets[c + 1]; ++r)
+      for (size_t k=classStart[runs[r].first]; k<classStart[runs[r].second]; ++k)
+        fn(bySize[k]);
+  };
+  // share of the pairs that mayPass (the rest is never scored)
+  double candidateShare() const { return share; };
+
+private:
+  std::vector<int> classOf;       // per term: index of its size among the distinct sizes
+  std::vector<int> bySize;        // terms ordered by size, then index
+  std::vector<size_t> classStart; // first position in bySize of every size (+ end)
+  std::vector<size_t> runOffsets; // runs of every size (+ end)
+  std::vector<std::pair<int, int>> runs; // [from, to) sizes that may pass
+  double share = 1.0;
+};
+
+#endif /* SizeBound_h */
@@ -0,0 +1,45 @@
+//
+//  SystemMemory.cpp
+//  richCluster
+//
+
+#include "SystemMemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+double availableMemoryBytes() {
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (!GlobalMemoryStatusEx(&status))
+    return 0.0;
+  return double(status.ullAvailPhys);
+}
+
+#else
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+double availableMemoryBytes() {
+  // Linux: MemAvailable counts reclaimable page cache, unlike free pages
+  std::ifstream meminfo("/proc/meminfo");
+  std::string key;
+  double kb;
+  while (meminfo >> key >> kb) {
+    if (key == "MemAvailable:")
+      return kb * 1024.0;
+    meminfo.ignore(256, '\n');
+  }
+#if defined(_SC_AVPHYS_PAGES)
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+#else
+  long pages = sysconf(_SC_PHYS_PAGES); // total, eg. on macOS
+#endif
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if (pages <= 0 || pageSize <= 0)
+    return 0.0;
+  return double(pages) * double(pageSize);
+}
+
+#endif
@@ -0,0 +1,13 @@
+//
+//  SystemMemory.h
+//  richCluster
+//
+
+#ifndef SystemMemory_h
+#define SystemMemory_h
+
+// physical memory available to a new allocation, in bytes (0 if unknown);
+// kept apart from the R headers, which clash with <windows.h>
+double availableMemoryBytes();
+
+#endif /* SystemMemory_h */